@@ -1,18 +1,56 @@
 #include "Tour.hpp"
-#include <iostream>
+#include "distance.hpp"
+#include "two_level_list.hpp"
+#include "io.hpp"
+#include "tour_pool.hpp"
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
+// Tours with at least this many cities switch to a two-level list on
+// the first flip, smaller tours are faster to reverse as arrays.
+static const int LIST_SIZE = 1000;
+// The relative error allowed in the tracked length by the verifier
+static const double LENGTH_TOLERANCE = 1e-6;
+
 void Tour::create_index(int size) {
-	_index = new int[size];
+	_index = TourPool::local().buffer(size);
 	for (int i = 0; i < size; ++i) {
 		int elem = _tour[i];
 		_index[elem] = i;
 	}
 }
 
+/// Brings the arrays up to date with the two-level list.
+/// @complexity O(n) if the arrays are stale, O(1) otherwise
+void Tour::sync() const {
+	if (!_stale)
+		return;
+	_list->write(_tour);
+	for (int i = 0; i < _size; ++i)
+		_index[_tour[i]] = i;
+	_stale = false;
+}
+
+/// Makes the arrays the only representation of the tour.
+void Tour::drop_list() {
+	if (!_list)
+		return;
+	sync();
+	delete _list;
+	_list = nullptr;
+}
+
 void Tour::copy_construct(const Tour &t) {
+	t.sync();
+	_list = nullptr;
+	_stale = false;
+	_dist = t._dist;
+	_length = t._length;
+	_journal = nullptr;
 	_size = t.size();
-	_tour = new int[t.size()];
+	_tour = TourPool::local().buffer(t.size());
 	
 	for (int i = 0; i < t.size(); ++i) {
 		_tour[i] = t._tour[i];
@@ -25,16 +63,42 @@ void Tour::move_construct(Tour &res) {
 	_tour = res._tour;
 	_size = res._size;
 	_index = res._index;
+	_list = res._list;
+	_stale = res._stale;
+	_dist = res._dist;
+	_length = res._length;
+	_journal = res._journal;
 	
-	res._tour = new int[0];
-	res._index = new int[0];
+	res._tour = nullptr;
+	res._index = nullptr;
 	res._size = 0;
+	res._list = nullptr;
+	res._stale = false;
+	res._dist = nullptr;
+	res._journal = nullptr;
+}
+
+/// Gives back the arrays to the pool of the calling thread.
+void Tour::release() {
+	delete _list;
+	TourPool &pool = TourPool::local();
+	pool.recycle_buffer(_tour, _size);
+	pool.recycle_buffer(_index, _size);
+}
+
+/// Allocates tours from the pool of the calling thread.
+void* Tour::operator new(size_t size) {
+	return TourPool::local().block(size);
+}
+
+/// Gives back the memory of a tour to the pool of the calling thread.
+void Tour::operator delete(void *p, size_t size) {
+	TourPool::local().recycle_block(p, size);
 }
 
 // Destruct
 Tour::~Tour() {
-	delete[] _tour;
-	delete[] _index;
+	release();
 	// Sanity check
 	_tour = nullptr;
 	_index = nullptr;
@@ -44,6 +108,11 @@ Tour::~Tour() {
 Tour::Tour(int *tour, int size) {
 	_size = size;
 	_tour = tour;
+	_list = nullptr;
+	_stale = false;
+	_dist = nullptr;
+	_length = 0;
+	_journal = nullptr;
 	create_index(size);
 }
 
@@ -54,8 +123,7 @@ Tour::Tour(const Tour &t) {
 
 // Copy-assign
 Tour& Tour::operator=(Tour &t) {
-	delete[] _tour;
-	delete[] _index;
+	release();
 	copy_construct(t);
 	return *this;
 }
@@ -73,8 +141,7 @@ int Tour::size() const {
 
 // Move-assign
 Tour& Tour::operator=(Tour &&res) {
-	delete[] _tour;
-	delete[] _index;
+	release();
 	move_construct(res);
 	return *this;
 }
@@ -84,6 +151,23 @@ Tour& Tour::operator=(Tour &&res) {
 /// @param b Second city to swap
 /// @complexity O(1)
 void Tour::swap(int a, int b) {
+	drop_list();
+	if (!_dist) {
+		exchange(a, b);
+		return;
+	}
+	// The edges starting at the positions before and at a and b
+	int starts[4] = { a == 0 ? _size - 1 : a - 1, a, b == 0 ? _size - 1 : b - 1, b };
+	std::sort(starts, starts + 4);
+	int count = std::unique(starts, starts + 4) - starts;
+	_length -= edges(starts, count);
+	exchange(a, b);
+	_length += edges(starts, count);
+	verify();
+}
+
+/// Swaps the cities at two positions without updating the length.
+void Tour::exchange(int a, int b) {
 	int city_a = _tour[a];
 	int city_b = _tour[b];
 	
@@ -96,19 +180,60 @@ void Tour::swap(int a, int b) {
 	_index[city_b] = tmp1;
 }
 
+/// Returns the total length of the edges starting at some positions.
+double Tour::edges(const int *starts, int count) const {
+	double sum = 0;
+	for (int i = 0; i < count; ++i) {
+		int p = starts[i];
+		sum += (*_dist)(_tour[p], _tour[p + 1 == _size ? 0 : p + 1]);
+	}
+	return sum;
+}
+
+/// Compares the tracked length with the length computed from scratch,
+/// after every move. This is only done in builds with TOUR_DEBUG
+/// defined, since it makes every move O(n).
+void Tour::verify() const {
+#ifdef TOUR_DEBUG
+	if (!_dist)
+		return;
+	double expected = 0;
+	for (int city = 0; city < _size; ++city)
+		expected += (*_dist)(city, next(city));
+	if (std::fabs(_length - expected) > LENGTH_TOLERANCE * std::max(1.0, expected))
+		throw std::logic_error("the tracked tour length is wrong");
+#endif
+}
+
+/// Makes the tour keep its length up to date with every move, such
+/// that length() is O(1) for this distance provider. The provider must
+/// outlive the tour, or another provider must be tracked instead.
+/// @param d Distance provider
+/// @complexity O(n) the first time, O(1) if d is already tracked
+void Tour::track(const Distance &d) {
+	if (_dist == &d)
+		return;
+	_dist = nullptr;
+	_length = length(d);
+	_dist = &d;
+}
+
 /// Compute the length of this tour.
-/// @param d Distance matrix
-/// @complexity O(n)
-double Tour::length(double **d) const {
+/// @param d Distance provider
+/// @complexity O(1) if d is tracked, O(n) otherwise
+double Tour::length(const Distance &d) const {
+	if (_dist == &d)
+		return _length;
+	sync();
 	double distance = 0;
 	for (int i = 0; i < _size-1; ++i) {
 		int from = _tour[i];
 		int to = _tour[i+1];
-		distance += d[from][to];
+		distance += d(from, to);
 	}
 	int from = _tour[_size-1];
 	int to = _tour[0];
-	distance += d[from][to];
+	distance += d(from, to);
 	return distance;
 }
 
@@ -118,7 +243,8 @@ double Tour::length(double **d) const {
 /// A[i] contains the i:th city to cisit.
 /// @complexity O(n)
 void Tour::transform() {
-	int *v = new int[_size];
+	drop_list();
+	int *v = TourPool::local().buffer(_size);
 	
 	int pos = 0, next = 0;
 	do {
@@ -127,24 +253,32 @@ void Tour::transform() {
 		pos++;
 	} while (pos < _size);
 	
-	delete[] _tour;
+	TourPool &pool = TourPool::local();
+	pool.recycle_buffer(_tour, _size);
 	_tour = v;
 	
-	delete[] _index;
+	pool.recycle_buffer(_index, _size);
 	create_index(_size);
+	if (_dist) {
+		const Distance *d = _dist;
+		_dist = nullptr;
+		track(*d);
+	}
 }
 
-/// Prints the tour to standard out.
+/// Prints the tour to standard out, one city per line.
+/// @param names The id to print for each city, or nullptr to print
+///        the cities as they are numbered in the tour
 /// @complexity O(n)
-void Tour::print() const {
-	for (int i = 0; i < _size; ++i) 
-		std::cout << _tour[i] << std::endl;
+void Tour::print(const int *names) const {
+	write_tour(STDOUT_FILENO, *this, TEXT, names);
 }
 
 /// Returns the city at index i.
 int Tour::operator[](int i) const {
 	if (i < 0 || i > _size)
 		throw std::out_of_range("operator[] out of range.");
+	sync();
 	if (i == _size) 
 		return _tour[0];
 	return _tour[i];
@@ -154,8 +288,20 @@ int Tour::operator[](int i) const {
 // rebuild the index using fix_index after invoking
 // this method.
 void Tour::set(int index, int value) {
+	drop_list();
+	if (!_dist) {
+		_tour[index] = value;
+		_index[value] = index;
+		return;
+	}
+	// The length is the sum over the edges between positions, which is
+	// well-defined even while the tour is being rebuilt
+	int starts[2] = { index == 0 ? _size - 1 : index - 1, index };
+	int count = _size > 1 && starts[0] != starts[1] ? 2 : 1;
+	_length -= edges(starts, count);
 	_tour[index] = value;
 	_index[value] = index;
+	_length += edges(starts, count);
 }
 
 /// Calculates the index of the city specified.
@@ -164,6 +310,136 @@ void Tour::set(int index, int value) {
 int Tour::index_of(int city) const {
 	if (city < 0 || city >= _size)
 		throw std::out_of_range("index_of out of range");
-		
+	sync();
 	return _index[city]; 
 }
+
+/// Returns the city visited after a city.
+/// @complexity O(1)
+int Tour::next(int city) const {
+	if (_list)
+		return _list->next(city);
+	int i = _index[city] + 1;
+	return _tour[i == _size ? 0 : i];
+}
+
+/// Returns the city visited before a city.
+/// @complexity O(1)
+int Tour::prev(int city) const {
+	if (_list)
+		return _list->prev(city);
+	int i = _index[city];
+	return _tour[i == 0 ? _size - 1 : i - 1];
+}
+
+/// Checks if b lies on the path from a to c, following next().
+/// @complexity O(1)
+bool Tour::between(int a, int b, int c) const {
+	if (_list)
+		return _list->between(a, b, c);
+	int i = _index[a], j = _index[b], k = _index[c];
+	if (i <= k)
+		return i <= j && j <= k;
+	return j >= i || j <= k;
+}
+
+/// Reverses the cities at the positions i to j, wrapping around
+/// the end of the tour if j < i.
+/// @complexity O(n)
+void Tour::reverse(int i, int j) {
+	int len = j - i;
+	if (len < 0)
+		len += _size;
+	for (int k = 0; k < (len + 1) / 2; ++k) {
+		exchange(i, j);
+		if (++i == _size) i = 0;
+		if (--j < 0) j = _size - 1;
+	}
+}
+
+/// Reverses the path from city a to city b. The shorter of the path
+/// and the rest of the tour is reversed, so afterwards the tour may
+/// be traversed in the opposite direction. Only the neighbours of a
+/// and b are well-defined after a flip. Large tours are switched to
+/// a two-level list, which makes the flip O(sqrt n).
+/// @param a The first city of the path
+/// @param b The last city of the path
+/// @complexity O(n) for small tours, O(sqrt n) otherwise
+void Tour::flip(int a, int b) {
+	if (_dist && a != b && next(b) != a) {
+		// The edges (p, a) and (b, n) are replaced by (p, b) and (a, n)
+		int p = prev(a), n = next(b);
+		const Distance &d = *_dist;
+		_length += d(p, b) + d(a, n) - d(p, a) - d(b, n);
+	}
+	flip_path(a, b);
+	verify();
+}
+
+/// Reverses the path from city a to city b without updating the length.
+void Tour::flip_path(int a, int b) {
+	if (!_list && _size >= LIST_SIZE)
+		_list = new TwoLevelList(_tour, _size);
+	if (_list) {
+		_list->flip(a, b);
+		_stale = true;
+		return;
+	}
+	int i = _index[a], j = _index[b];
+	int len = j - i;
+	if (len < 0)
+		len += _size;
+	if (2 * (len + 1) > _size) {
+		if (len + 1 == _size)
+			return; // Reversing the whole tour changes nothing
+		// Reverse the complement next(b) ... prev(a) instead
+		int tmp = i;
+		i = j + 1 == _size ? 0 : j + 1;
+		j = tmp == 0 ? _size - 1 : tmp - 1;
+	}
+	reverse(i, j);
+}
+
+/// Replaces the edges (a, b) and (c, d) with (a, c) and (b, d).
+/// Either b = next(a) and d = next(c), or b = prev(a) and
+/// d = prev(c).
+/// @complexity O(n)
+void Tour::two_opt(int a, int b, int c, int d) {
+	if (_journal) {
+		int move[4] = { a, b, c, d };
+		_journal->insert(_journal->end(), move, move + 4);
+	}
+	if (next(a) == b)
+		flip(b, c);
+	else
+		flip(a, d);
+}
+
+/// Starts recording the moves made with two_opt in a journal, four
+/// cities per move, such that they can be undone. Moves made in other
+/// ways are not recorded.
+/// @param journal The journal, or nullptr to stop recording
+void Tour::journal(std::vector<int> *journal) {
+	_journal = journal;
+}
+
+/// Returns the journal the moves are recorded in, or nullptr if they
+/// are not recorded.
+std::vector<int>* Tour::journal() const {
+	return _journal;
+}
+
+/// Undoes the moves in a journal, latest first, and empties it. The
+/// moves are not recorded again.
+/// @param journal The journal
+/// @complexity O(m) moves for a journal of m moves
+void Tour::undo(std::vector<int> &journal) {
+	std::vector<int> *recording = _journal;
+	_journal = nullptr;
+	for (size_t i = journal.size(); i >= 4; i -= 4) {
+		// Swap back the edges (a, c) and (b, d) for (a, b) and (c, d)
+		two_opt(journal[i-4], journal[i-2], journal[i-3], journal[i-1]);
+	}
+	journal.clear();
+	_journal = recording;
+}
@@ -1,16 +1,37 @@
 #ifndef __TOUR
 #define __TOUR
 
+#include <cstddef>
+#include <vector>
+
+class Distance;
+class TwoLevelList;
+
 class Tour {
 	int *_tour;
 	int *_index;
 	int _size;
+	TwoLevelList *_list;	// Used instead of the arrays for large tours
+	mutable bool _stale;	// _tour and _index lag behind _list
+	const Distance *_dist;	// The provider _length is kept for, if any
+	double _length;			// The length, updated by every move
+	std::vector<int> *_journal;	// Records two_opt moves, if not null
 	
 	void copy_construct(const Tour&);
 	void move_construct(Tour&);
 	void create_index(int);
+	void reverse(int, int);
+	void exchange(int, int);
+	void flip_path(int, int);
+	double edges(const int*, int) const;
+	void verify() const;
+	void sync() const;
+	void drop_list();
+	void release();
 
 	public:
+	static void* operator new(size_t);
+	static void operator delete(void*, size_t);
 	~Tour();
 	Tour(int*, int);
 	Tour(const Tour&);
@@ -18,13 +39,22 @@ class Tour {
 	Tour(Tour&&);
 	Tour& operator=(Tour&&);
 	void swap(int, int);
-	double length(double**) const;
+	double length(const Distance&) const;
+	void track(const Distance&);
 	int size() const;
 	void transform();
 	int index_of(int) const;
 	int operator[](int) const;
 	void set(int, int);
-	void print() const;
+	void print(const int* = nullptr) const;
+	int next(int) const;
+	int prev(int) const;
+	bool between(int, int, int) const;
+	void flip(int, int);
+	void two_opt(int, int, int, int);
+	void journal(std::vector<int>*);
+	std::vector<int>* journal() const;
+	void undo(std::vector<int>&);
 };
 
 #endif
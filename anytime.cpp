@@ -0,0 +1,91 @@
+#include "anytime.hpp"
+#include "tsptools.hpp"
+#include "ils.hpp"
+#include <chrono>
+#include <climits>
+
+typedef std::chrono::steady_clock Clock;
+
+// The share of the time budget spent on restarts, the rest is used
+// to improve the best tour found. Kicking a good tour finds better
+// tours faster than building new ones, so restarts get a small share.
+static const double RESTART_SHARE = 0.2;
+// Only start a restart if it is expected to finish with this margin
+static const double MARGIN = 1.5;
+// Relative improvement below which the tour is considered locally
+// optimal, smaller differences are rounding errors in the length
+static const double EPS = 1e-9;
+
+static double seconds_since(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Constructs a tour and improves it until it is locally optimal or
+/// the deadline expires.
+static Tour* restart(const Construction &construct, const Distance &d, const Candidates &cand,
+		Random &rng, const Deadline &deadline) {
+	Tour *t = construct(rng);
+	lin_kernighan(*t, d, cand, INT_MAX, deadline);
+	return t;
+}
+
+/// Keeps the shorter of two tours and deletes the other one.
+static Tour* keep_best(Tour *best, Tour *t, const Distance &d) {
+	if (t->length(d) < best->length(d)) {
+		delete best;
+		return t;
+	}
+	delete t;
+	return best;
+}
+
+/// Finds as short a tour as possible before the deadline. The time
+/// needed for one restart, i.e construction and local search, is
+/// measured on the first tour. If the construction is randomized,
+/// restarts are then made while they are expected to finish within the
+/// share of the budget given to them. After that the best tour is
+/// improved using 3-Opt and Lin-Kernighan until neither finds an
+/// improvement. Any time left is spent on iterated local search from
+/// the best tour. All phases stop when the deadline expires, so a valid
+/// tour is always returned in time.
+/// @param construct The construction heuristic, which should give up
+///                  when the deadline expires
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @param deadline The time when the best tour must be returned
+/// @param randomized False if the construction always builds the same
+///                   tour, which would make every restart identical
+Tour* anytime(const Construction &construct, const Distance &d, const Candidates &cand,
+		Random &rng, const Deadline &deadline, bool randomized) {
+	Clock::time_point start = Clock::now();
+	double budget = deadline.remaining();
+
+	Tour *best = restart(construct, d, cand, rng, deadline);
+	int restarts = 1;
+	double restart_time = seconds_since(start); // Time spent on restarts
+
+	// Restart phase
+	while (randomized && !deadline.expired() &&
+			seconds_since(start) + MARGIN * restart_time / restarts < RESTART_SHARE * budget) {
+		Clock::time_point t0 = Clock::now();
+		best = keep_best(best, restart(construct, d, cand, rng, deadline), d);
+		restart_time += seconds_since(t0);
+		++restarts;
+	}
+
+	// Improvement phase
+	double length = best->length(d);
+	while (!deadline.expired()) {
+		opt3(*best, d, cand, INT_MAX, deadline);
+		lin_kernighan(*best, d, cand, INT_MAX, deadline);
+		double improved = best->length(d);
+		if (improved >= length * (1 - EPS))
+			break;
+		length = improved;
+	}
+
+	// Spend the rest of the time kicking the best tour
+	ils(*best, d, cand, rng, deadline);
+	return best;
+}
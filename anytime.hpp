@@ -0,0 +1,13 @@
+#ifndef __ANYTIME
+#define __ANYTIME
+
+#include "Tour.hpp"
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "deadline.hpp"
+#include "construction.hpp"
+
+Tour* anytime(const Construction&, const Distance&, const Candidates&, Random&,
+	const Deadline&, bool = true);
+
+#endif
@@ -0,0 +1,73 @@
+#include "candidates.hpp"
+#include "kdtree.hpp"
+#include <algorithm>
+#include <cmath>
+
+Candidates::~Candidates() {
+	delete[] _list;
+	delete[] _dist;
+}
+
+/// Computes the candidate lists for a set of cities using a k-d tree.
+/// With quadrant neighbours enabled, up to k/4 of the closest cities
+/// are taken from each quadrant around the city and the rest of the
+/// list is filled with the closest remaining cities. This avoids lists
+/// which only point in one direction on clustered instances.
+/// @param cities The cities used to build the lists
+/// @param k The number of candidates per city
+/// @param quadrant Set to true to use quadrant neighbours
+/// @complexity O(n log n + nk log k)
+Candidates::Candidates(const std::vector<City> &cities, int k, bool quadrant) {
+	_size = cities.size();
+	_k = std::max(0, std::min(k, _size - 1));
+	_list = new int[static_cast<long>(_size) * _k];
+	_dist = new double[static_cast<long>(_size) * _k];
+
+	KDTree tree(cities);
+	// Scratch space for the k-d tree queries
+	std::vector<int> ids(2 * _k + 1);
+	std::vector<double> d2(2 * _k + 1);
+	std::vector<int> order(2 * _k + 1);
+
+	for (int i = 0; i < _size; ++i) {
+		const City &c = cities.at(i);
+		int *list = _list + static_cast<long>(i) * _k;
+		double *dist = _dist + static_cast<long>(i) * _k;
+		int found = 0;
+		if (quadrant && _k >= 4) {
+			for (int q = 0; q < 4; ++q)
+				found += tree.nearest(c.x, c.y, i, _k / 4, &ids[found], &d2[found], q);
+		}
+		// Fill up with the closest cities not already selected
+		int extra = tree.nearest(c.x, c.y, i, _k, &ids[found], &d2[found]);
+		int count = found;
+		for (int j = found; j < found + extra && count < _k; ++j) {
+			if (std::find(ids.begin(), ids.begin() + found, ids[j]) == ids.begin() + found) {
+				ids[count] = ids[j];
+				d2[count] = d2[j];
+				++count;
+			}
+		}
+
+		// Sort the selection by distance
+		for (int j = 0; j < count; ++j)
+			order[j] = j;
+		std::sort(order.begin(), order.begin() + count, [&d2](int a, int b) {
+			return d2[a] < d2[b];
+		});
+		for (int j = 0; j < count; ++j) {
+			list[j] = ids[order[j]];
+			dist[j] = std::sqrt(d2[order[j]]);
+		}
+	}
+}
+
+/// Returns the number of cities.
+int Candidates::size() const {
+	return _size;
+}
+
+/// Returns the length of each candidate list.
+int Candidates::k() const {
+	return _k;
+}
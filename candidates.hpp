@@ -0,0 +1,39 @@
+#ifndef __CANDIDATES
+#define __CANDIDATES
+
+#include "main.hpp"
+#include <vector>
+
+/// Bounded candidate lists, such that (*this)[i][p] is the p:th
+/// closest city to i (excluding i itself). Every list contains
+/// exactly k() cities and is sorted in ascending order of distance.
+/// The distances to the candidates are cached, so that they need not
+/// be recomputed when distances are computed on the fly.
+class Candidates {
+	int *_list;
+	double *_dist;
+	int _size;
+	int _k;
+
+	public:
+	~Candidates();
+	Candidates(const std::vector<City>&, int, bool = false);
+	Candidates(const Candidates&) = delete;
+	Candidates& operator=(const Candidates&) = delete;
+	int size() const;
+	int k() const;
+
+	/// Returns the candidate list of a city.
+	/// @complexity O(1)
+	const int* operator[](int city) const {
+		return _list + static_cast<long>(city) * _k;
+	}
+
+	/// Returns the distance from a city to its p:th candidate.
+	/// @complexity O(1)
+	double dist(int city, int p) const {
+		return _dist[static_cast<long>(city) * _k + p];
+	}
+};
+
+#endif
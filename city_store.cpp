@@ -0,0 +1,79 @@
+#include "city_store.hpp"
+#include "hilbert.hpp"
+#include <cstdlib>
+#include <new>
+
+// Alignment of the coordinate arrays
+static const size_t ALIGNMENT = 64;
+
+/// Allocates an array of doubles aligned on a cache line.
+static double* allocate(int size) {
+	void *p;
+	if (posix_memalign(&p, ALIGNMENT, (size > 0 ? size : 1) * sizeof(double)) != 0)
+		throw std::bad_alloc();
+	return static_cast<double*>(p);
+}
+
+CityStore::~CityStore() {
+	free(_x);
+	free(_y);
+}
+
+/// Copies the coordinates of a set of cities.
+/// @param cities The cities, in input order
+/// @param renumber Renumber the cities along a Hilbert curve
+/// @complexity O(n)
+CityStore::CityStore(const std::vector<City> &cities, bool renumber)
+	: _id(cities.size()), _size(cities.size()) {
+	_x = allocate(_size);
+	_y = allocate(_size);
+	if (renumber) {
+		hilbert_order(cities, _id.data());
+	} else {
+		for (int i = 0; i < _size; ++i)
+			_id[i] = i;
+	}
+	for (int i = 0; i < _size; ++i) {
+		const City &c = cities[_id[i]];
+		_x[i] = c.x;
+		_y[i] = c.y;
+	}
+}
+
+/// Returns the number of cities.
+int CityStore::size() const {
+	return _size;
+}
+
+/// Returns the x-coordinates of the cities.
+const double* CityStore::x() const {
+	return _x;
+}
+
+/// Returns the y-coordinates of the cities.
+const double* CityStore::y() const {
+	return _y;
+}
+
+/// Returns the id a city had in the input.
+int CityStore::original(int city) const {
+	return _id[city];
+}
+
+/// Returns the ids the cities had in the input, indexed by city.
+const int* CityStore::ids() const {
+	return _id.data();
+}
+
+/// Writes the cities in the order of the store. The name of each city
+/// is its original id.
+/// @param cities The output vector
+/// @complexity O(n)
+void CityStore::write(std::vector<City> &cities) const {
+	cities.resize(_size);
+	for (int i = 0; i < _size; ++i) {
+		cities[i].x = _x[i];
+		cities[i].y = _y[i];
+		cities[i].name = _id[i];
+	}
+}
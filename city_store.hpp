@@ -0,0 +1,44 @@
+#ifndef __CITY_STORE
+#define __CITY_STORE
+
+#include "main.hpp"
+#include <vector>
+#include <cmath>
+
+/// The coordinates of the cities as a structure of arrays. The x- and
+/// y-coordinates are kept in two separate arrays aligned on cache lines,
+/// so a kernel which only reads coordinates does not drag the rest of
+/// City through the cache.
+///
+/// The cities can be renumbered along a Hilbert curve, such that cities
+/// which are close in the plane also are close in memory. All other data
+/// structures are then built on the renumbered cities, and the original
+/// ids are only needed again when the tour is printed.
+class CityStore {
+	double *_x;
+	double *_y;
+	std::vector<int> _id;	// _id[i] is the original id of city i
+	int _size;
+
+	public:
+	~CityStore();
+	CityStore(const std::vector<City>&, bool = false);
+	CityStore(const CityStore&) = delete;
+	CityStore& operator=(const CityStore&) = delete;
+	int size() const;
+	const double* x() const;
+	const double* y() const;
+	int original(int) const;
+	const int* ids() const;
+	void write(std::vector<City>&) const;
+
+	/// Returns the distance between city a and city b.
+	/// @complexity O(1)
+	double dist(int a, int b) const {
+		double dx = _x[a] - _x[b];
+		double dy = _y[a] - _y[b];
+		return std::sqrt(dx*dx + dy*dy);
+	}
+};
+
+#endif
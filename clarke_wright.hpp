@@ -1,5 +1,10 @@
 #ifndef __CW
 #define __CW
+#include "main.hpp"
 #include "Tour.hpp"
-Tour* clarke_wright(double**, int);
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "random.hpp"
+#include <vector>
+Tour* clarke_wright(const std::vector<City>&, const Distance&, const Candidates&, Random&);
 #endif
\ No newline at end of file
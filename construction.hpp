@@ -0,0 +1,12 @@
+#ifndef __CONSTRUCTION
+#define __CONSTRUCTION
+
+#include "Tour.hpp"
+#include "random.hpp"
+#include <functional>
+
+/// A construction heuristic, which builds a new tour every time it is
+/// called. Randomized heuristics draw from the given generator.
+typedef std::function<Tour*(Random&)> Construction;
+
+#endif
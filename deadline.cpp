@@ -0,0 +1,26 @@
+#include "deadline.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+/// Creates a deadline which never expires.
+Deadline::Deadline() : _never(true) {}
+
+/// Creates a deadline the given number of seconds from now.
+/// @param seconds The time until the deadline
+Deadline::Deadline(double seconds) : _never(false) {
+	_end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(seconds));
+}
+
+/// Returns true if the deadline has passed.
+bool Deadline::expired() const {
+	return !_never && Clock::now() >= _end;
+}
+
+/// Returns the number of seconds left until the deadline, or a
+/// very large number if the deadline never expires.
+double Deadline::remaining() const {
+	if (_never)
+		return 1e18;
+	return std::chrono::duration<double>(_end - Clock::now()).count();
+}
@@ -0,0 +1,19 @@
+#ifndef __DEADLINE
+#define __DEADLINE
+
+#include <chrono>
+
+/// A point in wall-clock time after which a search should stop.
+/// A default constructed deadline never expires.
+class Deadline {
+	std::chrono::steady_clock::time_point _end;
+	bool _never;
+
+	public:
+	Deadline();
+	Deadline(double);
+	bool expired() const;
+	double remaining() const;
+};
+
+#endif
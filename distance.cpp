@@ -0,0 +1,128 @@
+#include "distance.hpp"
+#include <unistd.h>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+// Never spend more than this many bytes on a dense matrix, larger
+// matrices do not fit in the cache anyway and computing the distance
+// from the coordinates is just as fast.
+static const double DENSE_LIMIT = 1 << 30;
+
+// Alignment of the matrix buffer and of the rows in the square layout
+static const long ALIGNMENT = 64;
+
+Distance::~Distance() {
+	free(_matrix);
+}
+
+/// Creates a distance provider for a set of cities. The store must
+/// outlive the provider, since the matrix-free backend reads their
+/// coordinates. In automatic mode, the precision and layout are
+/// preferences, which are relaxed in that order until the matrix
+/// fits in memory.
+/// @param store The coordinates of the cities
+/// @param mode The backend to use
+/// @param precision The element type of the dense matrix
+/// @param layout The layout of the dense matrix
+/// @complexity O(n^2) for the dense backend, O(1) otherwise
+Distance::Distance(const CityStore &store, Mode mode, Precision precision,
+		Layout layout) {
+	_size = store.size();
+	_store = &store;
+	_matrix = nullptr;
+	if (mode == AUTO) {
+		if (!fits(_size, precision, layout) && fits(_size, FLOAT, layout))
+			precision = FLOAT;
+		if (!fits(_size, precision, layout) && fits(_size, precision, TRIANGULAR))
+			layout = TRIANGULAR;
+		mode = fits(_size, precision, layout) ? DENSE : ON_THE_FLY;
+	}
+	if (mode == ON_THE_FLY)
+		return;
+
+	_single = precision == FLOAT;
+	_packed = layout == TRIANGULAR;
+	long element = _single ? sizeof(float) : sizeof(double);
+	_stride = stride(_size, element);
+	long elements = _packed ? _size * (_size + 1L) / 2 : _size * _stride;
+	if (posix_memalign(&_matrix, ALIGNMENT, elements * element) != 0)
+		throw std::bad_alloc();
+
+	// Compute each distance once and mirror it
+	float *f = static_cast<float*>(_matrix);
+	double *d = static_cast<double*>(_matrix);
+	for (int i = 0; i < _size; ++i) {
+		for (int j = i; j < _size; ++j) {
+			double dist = store.dist(i, j);
+			if (_single) {
+				f[offset(i, j)] = dist;
+				f[offset(j, i)] = dist;
+			} else {
+				d[offset(i, j)] = dist;
+				d[offset(j, i)] = dist;
+			}
+		}
+	}
+}
+
+/// Returns the number of elements per row in the square layout, where
+/// every row is padded to a whole number of cache lines.
+/// @param n The number of cities
+/// @param element The size of an element in bytes
+long Distance::stride(int n, long element) {
+	long per_line = ALIGNMENT / element;
+	return (n + per_line - 1) / per_line * per_line;
+}
+
+/// Returns the number of cities.
+int Distance::size() const {
+	return _size;
+}
+
+/// Returns true if the distances are looked up in a matrix.
+bool Distance::dense() const {
+	return _matrix != nullptr;
+}
+
+/// Returns the coordinates the distances are computed from, or nullptr
+/// if the distances are looked up in the matrix.
+const CityStore* Distance::coordinates() const {
+	return _matrix ? nullptr : _store;
+}
+
+/// Returns the number of bytes used by the dense matrix.
+double Distance::bytes() const {
+	if (!_matrix)
+		return 0;
+	double element = _single ? sizeof(float) : sizeof(double);
+	if (_packed)
+		return element * _size * (_size + 1.0) / 2;
+	return element * _size * _stride;
+}
+
+/// Returns the number of bytes needed by a dense matrix, including
+/// the padding of the rows in the square layout.
+/// @param n The number of cities
+/// @param precision The element type
+/// @param layout The layout of the matrix
+double Distance::bytes(int n, Precision precision, Layout layout) {
+	long element = precision == FLOAT ? sizeof(float) : sizeof(double);
+	if (layout == TRIANGULAR)
+		return element * n * (n + 1.0) / 2;
+	return static_cast<double>(element) * n * stride(n, element);
+}
+
+/// Checks if a dense matrix for n cities fits within the memory
+/// budget, which is a quarter of the physical memory.
+/// @param n The number of cities
+/// @param precision The element type
+/// @param layout The layout of the matrix
+bool Distance::fits(int n, Precision precision, Layout layout) {
+	double budget = DENSE_LIMIT;
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	if (pages > 0 && page_size > 0)
+		budget = std::min(budget, static_cast<double>(pages) * page_size / 4);
+	return bytes(n, precision, layout) <= budget;
+}
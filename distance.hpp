@@ -0,0 +1,78 @@
+#ifndef __DISTANCE
+#define __DISTANCE
+
+#include "city_store.hpp"
+
+/// Provides the distance between two cities. The distances are either
+/// looked up in a dense precomputed matrix, or computed on the fly from
+/// the coordinates of the cities when the matrix would not fit in memory.
+/// Distances to the candidate neighbours of a city are cached separately
+/// by Candidates.
+///
+/// The dense matrix is stored in one contiguous buffer. Rows of the
+/// square layout are padded to start on a cache line. The triangular
+/// layout only stores d[i][j] for i <= j, which halves the memory.
+class Distance {
+	void *_matrix;			// Dense backend, nullptr if matrix-free
+	const CityStore *_store;	// Coordinates for the matrix-free backend
+	long _stride;			// Elements per row in the square layout
+	int _size;
+	bool _single;			// Elements are float rather than double
+	bool _packed;			// Triangular rather than square layout
+
+	static long stride(int, long);
+
+	/// Returns the offset of d[a][b] in the matrix.
+	long offset(int a, int b) const {
+		if (!_packed)
+			return a * _stride + b;
+		if (a > b) {
+			int tmp = a;
+			a = b;
+			b = tmp;
+		}
+		// Row a starts after the rows 0..a-1 of length n, n-1, ...
+		return a * (2L * _size - a + 1) / 2 + (b - a);
+	}
+
+	public:
+	enum Mode {
+		AUTO,		// Pick a backend based on size and available memory
+		DENSE,		// Precompute the full distance matrix
+		ON_THE_FLY	// Compute distances from the coordinates
+	};
+
+	enum Precision {
+		DOUBLE,		// 64-bit matrix elements
+		FLOAT		// 32-bit matrix elements
+	};
+
+	enum Layout {
+		SQUARE,		// Both d[i][j] and d[j][i] are stored
+		TRIANGULAR	// Only d[i][j] for i <= j is stored
+	};
+
+	~Distance();
+	Distance(const CityStore&, Mode = AUTO, Precision = DOUBLE, Layout = SQUARE);
+	Distance(const Distance&) = delete;
+	Distance& operator=(const Distance&) = delete;
+	int size() const;
+	bool dense() const;
+	const CityStore* coordinates() const;
+	double bytes() const;
+	static double bytes(int, Precision, Layout);
+	static bool fits(int, Precision = DOUBLE, Layout = SQUARE);
+
+	/// Returns the distance between city a and city b.
+	/// @complexity O(1)
+	double operator()(int a, int b) const {
+		if (!_matrix)
+			return _store->dist(a, b);
+		long i = offset(a, b);
+		if (_single)
+			return static_cast<const float*>(_matrix)[i];
+		return static_cast<const double*>(_matrix)[i];
+	}
+};
+
+#endif
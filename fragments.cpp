@@ -0,0 +1,98 @@
+#include "fragments.hpp"
+#include "kdtree.hpp"
+#include "tour_pool.hpp"
+#include <algorithm>
+
+// The number of nearby end points examined when joining the fragments
+// left over by a construction heuristic. Doubled whenever a round of
+// joining makes no progress.
+static const int JOIN_NEIGHBOURS = 8;
+
+/// Creates n fragments of a single city each.
+/// @complexity O(n)
+Fragments::Fragments(int n) : _adj(2 * n, -1), _sets(n), _size(n), _edges(0) {}
+
+/// Returns the number of edges at a city.
+int Fragments::degree(int c) const {
+	return (_adj[2 * c] != -1) + (_adj[2 * c + 1] != -1);
+}
+
+/// Returns the number of edges added so far.
+int Fragments::edges() const {
+	return _edges;
+}
+
+/// Checks if the edge (a, b) joins the ends of two fragments.
+/// @complexity O(α(n)) amortized
+bool Fragments::can_link(int a, int b) {
+	return a != b && degree(a) < 2 && degree(b) < 2 && _sets.find(a) != _sets.find(b);
+}
+
+/// Adds the edge (a, b), which must join the ends of two fragments.
+void Fragments::link(int a, int b) {
+	_adj[2 * a + (_adj[2 * a] != -1)] = b;
+	_adj[2 * b + (_adj[2 * b] != -1)] = a;
+	_sets.unite(a, b);
+	++_edges;
+}
+
+/// Joins the remaining fragments into one tour. In each round, the
+/// edges from every end point to its closest end points are added
+/// greedily, shortest first, until one fragment is left. The tour
+/// follows that fragment and returns from its last city to the first.
+/// @param cities The coordinates of the cities
+/// @return The tour
+/// @complexity O(f log f) per round, where f is the number of fragments
+Tour* Fragments::tour(const std::vector<City> &cities) {
+	struct Edge {
+		int a, b;
+		double d2;
+	};
+	int k = JOIN_NEIGHBOURS;
+	while (_edges < _size - 1) {
+		std::vector<int> ends;
+		std::vector<City> points;
+		for (int c = 0; c < _size; ++c) {
+			if (degree(c) < 2) {
+				ends.push_back(c);
+				points.push_back(cities[c]);
+			}
+		}
+		KDTree tree(points);
+		int m = std::min<int>(k, ends.size() - 1);
+		std::vector<int> ids(m);
+		std::vector<double> d2(m);
+		std::vector<Edge> edges;
+		for (size_t i = 0; i < ends.size(); ++i) {
+			int found = tree.nearest(points[i].x, points[i].y, i, m, ids.data(), d2.data());
+			for (int j = 0; j < found; ++j) {
+				Edge e = { ends[i], ends[ids[j]], d2[j] };
+				edges.push_back(e);
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const Edge &x, const Edge &y) {
+			return x.d2 < y.d2;
+		});
+		int before = _edges;
+		for (size_t i = 0; i < edges.size() && _edges < _size - 1; ++i) {
+			if (can_link(edges[i].a, edges[i].b))
+				link(edges[i].a, edges[i].b);
+		}
+		if (_edges == before)
+			k *= 2;
+	}
+
+	// Follow the last fragment from one of its ends
+	int *tour = TourPool::local().buffer(_size);
+	int start = 0;
+	while (degree(start) == 2)
+		++start;
+	int prev = -1, c = start;
+	for (int i = 0; i < _size; ++i) {
+		tour[i] = c;
+		int next = _adj[2 * c] != prev ? _adj[2 * c] : _adj[2 * c + 1];
+		prev = c;
+		c = next;
+	}
+	return new Tour(tour, _size);
+}
@@ -0,0 +1,28 @@
+#ifndef __FRAGMENTS
+#define __FRAGMENTS
+
+#include "main.hpp"
+#include "Tour.hpp"
+#include "union_find.hpp"
+#include <vector>
+
+/// A set of paths (fragments) covering all cities, which are grown
+/// into a tour by adding edges. Greedy construction heuristics add
+/// edges in some order of preference, and an edge may only be added
+/// if both of its cities are end points of different fragments.
+class Fragments {
+	std::vector<int> _adj;	// _adj[2c] and _adj[2c+1] are the neighbours of c
+	UnionFind _sets;		// The cities of each fragment
+	int _size;
+	int _edges;
+
+	public:
+	Fragments(int);
+	int degree(int) const;
+	int edges() const;
+	bool can_link(int, int);
+	void link(int, int);
+	Tour* tour(const std::vector<City>&);
+};
+
+#endif
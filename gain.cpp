@@ -0,0 +1,111 @@
+#include "gain.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GAIN_X86
+#include <immintrin.h>
+#endif
+
+// The gains of a batch of moves from the coordinates of the cities
+typedef void (*Kernel)(const double*, const double*, int, int, double, const int*,
+	const int*, int, double*);
+
+/// Computes the gains one at a time. The distances are computed exactly
+/// as by CityStore::dist, so all kernels agree to the last bit.
+static void gains_scalar(const double *x, const double *y, int a, int b, double d_ab,
+		const int *c, const int *e, int count, double *gain) {
+	for (int i = 0; i < count; ++i) {
+		double dx = x[a] - x[c[i]], dy = y[a] - y[c[i]];
+		double d_ac = std::sqrt(dx*dx + dy*dy);
+		dx = x[c[i]] - x[e[i]];
+		dy = y[c[i]] - y[e[i]];
+		double d_ce = std::sqrt(dx*dx + dy*dy);
+		dx = x[b] - x[e[i]];
+		dy = y[b] - y[e[i]];
+		double d_be = std::sqrt(dx*dx + dy*dy);
+		gain[i] = d_ab - d_ac + d_ce - d_be;
+	}
+}
+
+#ifdef GAIN_X86
+/// Loads four coordinates. The masked gather is used since the plain one
+/// leaves its source undefined, which GCC warns about.
+__attribute__((target("avx2")))
+static inline __m256d gather(const double *v, __m128i index) {
+	__m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+	return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), v, index, all, 8);
+}
+
+/// Computes four gains at a time, gathering the coordinates of the
+/// candidates. FMA is deliberately not enabled, since contracting the
+/// squares would round differently from the scalar distances.
+__attribute__((target("avx2")))
+static void gains_avx2(const double *x, const double *y, int a, int b, double d_ab,
+		const int *c, const int *e, int count, double *gain) {
+	__m256d ax = _mm256_set1_pd(x[a]), ay = _mm256_set1_pd(y[a]);
+	__m256d bx = _mm256_set1_pd(x[b]), by = _mm256_set1_pd(y[b]);
+	__m256d ab = _mm256_set1_pd(d_ab);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i ci = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+		__m128i ei = _mm_loadu_si128(reinterpret_cast<const __m128i*>(e + i));
+		__m256d cx = gather(x, ci), cy = gather(y, ci);
+		__m256d ex = gather(x, ei), ey = gather(y, ei);
+		__m256d dx = _mm256_sub_pd(ax, cx), dy = _mm256_sub_pd(ay, cy);
+		__m256d ac = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+		dx = _mm256_sub_pd(cx, ex);
+		dy = _mm256_sub_pd(cy, ey);
+		__m256d ce = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+		dx = _mm256_sub_pd(bx, ex);
+		dy = _mm256_sub_pd(by, ey);
+		__m256d be = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+		_mm256_storeu_pd(gain + i, _mm256_sub_pd(_mm256_add_pd(_mm256_sub_pd(ab, ac), ce), be));
+	}
+	gains_scalar(x, y, a, b, d_ab, c + i, e + i, count - i, gain + i);
+}
+
+/// Computes two gains at a time. SSE2 is part of x86-64, so this is the
+/// fallback when AVX2 is missing.
+__attribute__((target("sse2")))
+static void gains_sse2(const double *x, const double *y, int a, int b, double d_ab,
+		const int *c, const int *e, int count, double *gain) {
+	__m128d ax = _mm_set1_pd(x[a]), ay = _mm_set1_pd(y[a]);
+	__m128d bx = _mm_set1_pd(x[b]), by = _mm_set1_pd(y[b]);
+	__m128d ab = _mm_set1_pd(d_ab);
+	int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128d cx = _mm_set_pd(x[c[i+1]], x[c[i]]), cy = _mm_set_pd(y[c[i+1]], y[c[i]]);
+		__m128d ex = _mm_set_pd(x[e[i+1]], x[e[i]]), ey = _mm_set_pd(y[e[i+1]], y[e[i]]);
+		__m128d dx = _mm_sub_pd(ax, cx), dy = _mm_sub_pd(ay, cy);
+		__m128d ac = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+		dx = _mm_sub_pd(cx, ex);
+		dy = _mm_sub_pd(cy, ey);
+		__m128d ce = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+		dx = _mm_sub_pd(bx, ex);
+		dy = _mm_sub_pd(by, ey);
+		__m128d be = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+		_mm_storeu_pd(gain + i, _mm_sub_pd(_mm_add_pd(_mm_sub_pd(ab, ac), ce), be));
+	}
+	gains_scalar(x, y, a, b, d_ab, c + i, e + i, count - i, gain + i);
+}
+#endif
+
+/// Picks the widest kernel supported by the CPU.
+static Kernel pick_kernel() {
+#ifdef GAIN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return gains_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return gains_sse2;
+#endif
+	return gains_scalar;
+}
+
+/// Computes the gains of a batch of 2-Opt moves, see two_opt_gains,
+/// with the widest SIMD kernel supported by the CPU.
+/// @complexity O(count)
+void vector_gains(const CityStore &store, int a, int b, double d_ab, const int *c,
+		const int *e, int count, double *gain) {
+	static const Kernel kernel = pick_kernel();
+	kernel(store.x(), store.y(), a, b, d_ab, c, e, count, gain);
+}
@@ -0,0 +1,38 @@
+#ifndef __GAIN
+#define __GAIN
+
+#include "distance.hpp"
+
+// The largest number of moves evaluated by one call to two_opt_gains
+const int GAIN_BATCH = 16;
+// Smaller batches are not worth the call to a vector kernel
+const int GAIN_VECTOR_MIN = 4;
+
+void vector_gains(const CityStore&, int, int, double, const int*, const int*, int, double*);
+
+/// Computes the gains of a batch of 2-Opt moves which all remove the
+/// edge (a, b). Move i removes the edge (c[i], e[i]) as well, and adds
+/// the edges (a, c[i]) and (b, e[i]). Large enough batches are handed to
+/// a SIMD kernel when the distances are computed on the fly, and their
+/// gains are identical to the ones computed through the distance provider.
+/// @param d The distance provider
+/// @param a The first city of the fixed edge
+/// @param b The second city of the fixed edge
+/// @param d_ab The distance between a and b
+/// @param c The candidates of a
+/// @param e The tour neighbours of the candidates
+/// @param count The number of moves, at most GAIN_BATCH
+/// @param gain The output array, the gain of each move
+/// @complexity O(count)
+inline void two_opt_gains(const Distance &d, int a, int b, double d_ab, const int *c,
+		const int *e, int count, double *gain) {
+	const CityStore *store = d.coordinates();
+	if (store && count >= GAIN_VECTOR_MIN) {
+		vector_gains(*store, a, b, d_ab, c, e, count, gain);
+		return;
+	}
+	for (int i = 0; i < count; ++i)
+		gain[i] = d_ab - d(a, c[i]) + d(c[i], e[i]) - d(b, e[i]);
+}
+
+#endif
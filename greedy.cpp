@@ -0,0 +1,45 @@
+#include "greedy.hpp"
+#include "fragments.hpp"
+#include <algorithm>
+
+/// An edge between a city and one of its candidates.
+struct CandidateEdge {
+	int a;
+	int b;
+	double dist;
+};
+
+/// Greedy edge construction, also known as greedy matching. The edges
+/// of the candidate graph are added in order of increasing length,
+/// skipping every edge which would give a city a degree above two or
+/// close a subtour. The fragments left when the candidate edges run
+/// out are joined greedily.
+/// @param cities The cities
+/// @param cand The candidate lists
+/// @complexity O(nk log nk)
+Tour* greedy(const std::vector<City> &cities, const Candidates &cand) {
+	int size = cities.size();
+	std::vector<CandidateEdge> edges;
+	edges.reserve(static_cast<long>(size) * cand.k());
+	for (int a = 0; a < size; ++a) {
+		const int *near = cand[a];
+		for (int p = 0; p < cand.k(); ++p) {
+			int b = near[p];
+			// Only add an edge once if it is in both candidate lists
+			if (b < a && std::find(cand[b], cand[b] + cand.k(), a) != cand[b] + cand.k())
+				continue;
+			CandidateEdge e = { a, b, cand.dist(a, p) };
+			edges.push_back(e);
+		}
+	}
+	std::sort(edges.begin(), edges.end(), [](const CandidateEdge &x, const CandidateEdge &y) {
+		return x.dist < y.dist;
+	});
+
+	Fragments fragments(size);
+	for (size_t i = 0; i < edges.size() && fragments.edges() < size - 1; ++i) {
+		if (fragments.can_link(edges[i].a, edges[i].b))
+			fragments.link(edges[i].a, edges[i].b);
+	}
+	return fragments.tour(cities);
+}
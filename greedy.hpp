@@ -0,0 +1,11 @@
+#ifndef __GREEDY
+#define __GREEDY
+
+#include "main.hpp"
+#include "Tour.hpp"
+#include "candidates.hpp"
+#include <vector>
+
+Tour* greedy(const std::vector<City>&, const Candidates&);
+
+#endif
@@ -0,0 +1,127 @@
+#include "grid.hpp"
+#include <algorithm>
+#include <cmath>
+
+// The average number of cities per cell when all cities are added
+static const double CITIES_PER_CELL = 2;
+
+/// Creates an empty grid covering a set of cities. The cities must
+/// outlive the grid.
+/// @param cities The cities which may be added
+/// @complexity O(n)
+Grid::Grid(const std::vector<City> &cities) : _cities(cities.data()), _size(cities.size()) {
+	_min_x = _min_y = 0;
+	double max_x = 0, max_y = 0;
+	for (int i = 0; i < _size; ++i) {
+		const City &c = cities[i];
+		if (i == 0 || c.x < _min_x) _min_x = c.x;
+		if (i == 0 || c.y < _min_y) _min_y = c.y;
+		if (i == 0 || c.x > max_x) max_x = c.x;
+		if (i == 0 || c.y > max_y) max_y = c.y;
+	}
+	_width = max_x - _min_x;
+	_height = max_y - _min_y;
+	layout(1);
+}
+
+/// Sizes the cells for a number of cities and puts the cities added
+/// so far into the new cells.
+/// @complexity O(m), where m is the number of cities planned for
+void Grid::layout(int planned) {
+	_planned = std::min(planned, _size);
+	int m = std::max(_planned, 1);
+	double area = std::max(_width * _height, std::max(_width, _height) * 1e-9);
+	_cell = std::sqrt(area * CITIES_PER_CELL / m);
+	if (!(_cell > 0))
+		_cell = 1; // All cities in the same place
+	// Degenerate instances, e.g cities on a line, can need far more
+	// cells than cities, make the cells larger until they do not
+	while ((std::floor(_width / _cell) + 1) * (std::floor(_height / _cell) + 1) > 4.0 * m + 4)
+		_cell *= 2;
+	_cols = static_cast<int>(_width / _cell) + 1;
+	_rows = static_cast<int>(_height / _cell) + 1;
+	_cells.assign(static_cast<long>(_cols) * _rows, std::vector<int>());
+	for (size_t i = 0; i < _added.size(); ++i) {
+		const City &c = _cities[_added[i]];
+		_cells[static_cast<long>(row(c.y)) * _cols + column(c.x)].push_back(_added[i]);
+	}
+}
+
+int Grid::column(double x) const {
+	return std::max(0, std::min(_cols - 1, static_cast<int>((x - _min_x) / _cell)));
+}
+
+int Grid::row(double y) const {
+	return std::max(0, std::min(_rows - 1, static_cast<int>((y - _min_y) / _cell)));
+}
+
+/// Returns the number of cities added.
+int Grid::size() const {
+	return _added.size();
+}
+
+/// Adds a city to the grid.
+/// @complexity O(1) amortized
+void Grid::add(int city) {
+	_added.push_back(city);
+	if (static_cast<int>(_added.size()) > _planned) {
+		layout(2 * _added.size());
+		return;
+	}
+	const City &c = _cities[city];
+	_cells[static_cast<long>(row(c.y)) * _cols + column(c.x)].push_back(city);
+}
+
+/// Finds the k added cities closest to the point (x, y). The rings of
+/// cells around the point are searched until the closest unsearched
+/// cell is farther away than the k:th closest city found.
+/// @param x The x-coordinate of the query point
+/// @param y The y-coordinate of the query point
+/// @param k The maximum number of cities to return
+/// @param ids The closest cities in ascending order of distance (output)
+/// @param d2 The squared distances of the cities in ids (output)
+/// @return The number of cities found
+/// @complexity O(k + r^2), where r is the number of rings searched
+int Grid::nearest(double x, double y, int k, int *ids, double *d2) const {
+	int count = 0;
+	if (k <= 0)
+		return 0;
+	int cx = column(x), cy = row(y);
+	int rings = std::max(std::max(cx, _cols - 1 - cx), std::max(cy, _rows - 1 - cy));
+	for (int r = 0; r <= rings; ++r) {
+		// The cells at Chebyshev distance r from (cx, cy)
+		for (int j = cy - r; j <= cy + r; ++j) {
+			if (j < 0 || j >= _rows)
+				continue;
+			bool edge = j == cy - r || j == cy + r;
+			for (int i = cx - r; i <= cx + r; i += edge ? 1 : 2 * r) {
+				if (i >= 0 && i < _cols) {
+					const std::vector<int> &cell = _cells[static_cast<long>(j) * _cols + i];
+					for (size_t p = 0; p < cell.size(); ++p) {
+						const City &c = _cities[cell[p]];
+						double dx = c.x - x, dy = c.y - y;
+						double dist = dx*dx + dy*dy;
+						if (count == k && dist >= d2[k-1])
+							continue;
+						// Insert into the sorted result, dropping the farthest
+						int pos = count < k ? count++ : k - 1;
+						while (pos > 0 && d2[pos-1] > dist) {
+							d2[pos] = d2[pos-1];
+							ids[pos] = ids[pos-1];
+							--pos;
+						}
+						d2[pos] = dist;
+						ids[pos] = cell[p];
+					}
+				}
+				if (r == 0)
+					break;
+			}
+		}
+		// Every unsearched cell is at least r cells away
+		double reach = r * _cell;
+		if (count == k && d2[k-1] <= reach * reach)
+			break;
+	}
+	return count;
+}
@@ -0,0 +1,36 @@
+#ifndef __GRID
+#define __GRID
+
+#include "main.hpp"
+#include <vector>
+
+/// A uniform grid over the bounding box of a set of cities, into which
+/// cities are added one by one. The cell size is chosen such that a
+/// cell holds a couple of the cities added so far, and the grid is
+/// rebuilt with smaller cells whenever the number of cities doubles.
+/// Nearest neighbour queries search rings of cells around the query
+/// point, so they are fast when the added cities are spread out
+/// evenly, as they are in insertion heuristics.
+class Grid {
+	const City *_cities;
+	std::vector<std::vector<int> > _cells;
+	std::vector<int> _added;	// The cities added, in order
+	double _min_x, _min_y;
+	double _width, _height;
+	double _cell;		// Side of a cell
+	int _cols, _rows;
+	int _size;			// The number of cities which may be added
+	int _planned;		// The number of cities the cells are sized for
+
+	void layout(int);
+	int column(double) const;
+	int row(double) const;
+
+	public:
+	Grid(const std::vector<City>&);
+	int size() const;
+	void add(int);
+	int nearest(double, double, int, int*, double*) const;
+};
+
+#endif
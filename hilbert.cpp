@@ -0,0 +1,96 @@
+#include "hilbert.hpp"
+#include "tour_pool.hpp"
+#include <algorithm>
+
+// The coordinates are mapped to a grid of 2^ORDER x 2^ORDER cells,
+// which makes the curve index fit in 32 bits.
+static const int ORDER = 16;
+// The number of bits sorted per radix sort pass
+static const int RADIX_BITS = 16;
+
+/// Returns the index of the cell (x, y) along the Hilbert curve which
+/// fills the grid.
+static unsigned hilbert_index(unsigned x, unsigned y) {
+	const unsigned n = 1u << ORDER;
+	unsigned d = 0;
+	for (unsigned s = n / 2; s > 0; s /= 2) {
+		unsigned rx = (x & s) != 0;
+		unsigned ry = (y & s) != 0;
+		d += s * s * ((3 * rx) ^ ry);
+		// Rotate the quadrant, so that the curve inside it has the
+		// same orientation as the whole curve
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
+
+/// Computes the order in which a Hilbert curve over the bounding box
+/// of the cities visits them. Cities which are close along the curve
+/// are close in the plane.
+/// @param cities The cities
+/// @param order The output array, order[i] is the i:th city visited
+/// @complexity O(n), using a radix sort on the curve indices
+void hilbert_order(const std::vector<City> &cities, int *order) {
+	int size = cities.size();
+	if (size == 0)
+		return;
+	double min_x = cities[0].x, max_x = min_x, min_y = cities[0].y, max_y = min_y;
+	for (int i = 1; i < size; ++i) {
+		min_x = std::min(min_x, cities[i].x);
+		max_x = std::max(max_x, cities[i].x);
+		min_y = std::min(min_y, cities[i].y);
+		max_y = std::max(max_y, cities[i].y);
+	}
+	// Use the same scale for both axes, so that the curve is not skewed
+	double extent = std::max(max_x - min_x, max_y - min_y);
+	double scale = extent > 0 ? ((1u << ORDER) - 1) / extent : 0;
+
+	std::vector<unsigned> key(size);
+	std::vector<int> tmp(size);
+	for (int i = 0; i < size; ++i) {
+		unsigned x = static_cast<unsigned>((cities[i].x - min_x) * scale);
+		unsigned y = static_cast<unsigned>((cities[i].y - min_y) * scale);
+		key[i] = hilbert_index(x, y);
+		order[i] = i;
+	}
+
+	// Least significant digit first radix sort, which is stable
+	const unsigned buckets = 1u << RADIX_BITS;
+	std::vector<int> count(buckets);
+	int *from = order, *to = tmp.data();
+	for (int shift = 0; shift < 2 * ORDER; shift += RADIX_BITS) {
+		std::fill(count.begin(), count.end(), 0);
+		for (int i = 0; i < size; ++i)
+			++count[(key[from[i]] >> shift) & (buckets - 1)];
+		int sum = 0;
+		for (unsigned b = 0; b < buckets; ++b) {
+			int c = count[b];
+			count[b] = sum;
+			sum += c;
+		}
+		for (int i = 0; i < size; ++i)
+			to[count[(key[from[i]] >> shift) & (buckets - 1)]++] = from[i];
+		std::swap(from, to);
+	}
+	if (from != order)
+		std::copy(from, from + size, order);
+}
+
+/// Space filling curve construction. The cities are visited in the
+/// order of a Hilbert curve, which gives tours about 25% above optimal
+/// in linear time. Useful as a start for very large instances, and as
+/// a fallback when there is no time for anything else.
+/// @param cities The cities
+/// @complexity O(n)
+Tour* hilbert(const std::vector<City> &cities) {
+	int size = cities.size();
+	int *tour = TourPool::local().buffer(size);
+	hilbert_order(cities, tour);
+	return new Tour(tour, size);
+}
@@ -0,0 +1,11 @@
+#ifndef __HILBERT
+#define __HILBERT
+
+#include "main.hpp"
+#include "Tour.hpp"
+#include <vector>
+
+void hilbert_order(const std::vector<City>&, int*);
+Tour* hilbert(const std::vector<City>&);
+
+#endif
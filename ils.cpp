@@ -0,0 +1,81 @@
+#include "ils.hpp"
+#include "tsptools.hpp"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+// The longest segment moved by a kick
+static const int KICK_SEGMENT = 50;
+
+/// Returns the city a number of steps after a city.
+static int walk(const Tour &t, int city, int steps) {
+	for (int i = 0; i < steps; ++i)
+		city = t.next(city);
+	return city;
+}
+
+/// Applies a segment-local double-bridge kick, which swaps two short
+/// adjacent segments starting at a random city:
+/// a [b1..b2][c1..c2] d  =>  a [c1..c2][b1..b2] d
+/// The kick is made with three 2-Opt moves, so it is recorded in the
+/// journal of the tour.
+/// @param t The tour
+/// @param rng The random number generator
+/// @param segment The longest segment, at most (n - 2) / 2
+/// @param touched The output array, the six cities whose edges changed
+static void kick(Tour &t, Random &rng, int segment, int *touched) {
+	int a = random_int(rng, t.size());
+	int b1 = t.next(a);
+	int b2 = walk(t, b1, random_int(rng, segment));
+	int c1 = t.next(b2);
+	int c2 = walk(t, c1, random_int(rng, segment));
+	int d = t.next(c2);
+	t.two_opt(a, b1, c2, d);	// a [c2..c1][b2..b1] d
+	t.two_opt(a, c2, c1, b2);	// a [c1..c2][b2..b1] d
+	t.two_opt(c2, b2, b1, d);	// a [c1..c2][b1..b2] d
+	int cities[6] = { a, b1, b2, c1, c2, d };
+	std::copy(cities, cities + 6, touched);
+}
+
+/// Iterated local search. Each iteration kicks the tour with a local
+/// double bridge, and repairs it with Lin-Kernighan and Or-Opt, where
+/// only the cities touched by the kick are active at first. If the
+/// tour became longer, all moves of the iteration are undone using the
+/// journal of the tour. Lin-Kernighan only journals the moves it keeps,
+/// so undoing replays the net change rather than every trial move. The
+/// length is tracked by the tour, so both the local search and the
+/// decision cost time proportional to the number of changed edges
+/// rather than to the size of the tour.
+/// @param t The tour to improve, which is never made longer
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @param deadline Stop when this deadline has expired
+void ils(Tour &t, const Distance &d, const Candidates &cand, Random &rng,
+		const Deadline &deadline) {
+	int n = t.size();
+	if (n < 8)
+		return;
+	t.track(d);
+	int segment = std::min(KICK_SEGMENT, (n - 2) / 2);
+	// Every thread reuses its queue and journal
+	thread_local ActiveQueue queue(0);
+	thread_local std::vector<int> journal;
+	queue.reset(n);
+	while (!deadline.expired()) {
+		double length = t.length(d);
+		journal.clear();
+		t.journal(&journal);
+		int touched[6];
+		kick(t, rng, segment, touched);
+		for (int i = 0; i < 6; ++i)
+			queue.push(touched[i]);
+		lin_kernighan(t, d, cand, queue, INT_MAX, deadline);
+		t.journal(nullptr);
+		if (t.length(d) > length)
+			t.undo(journal);
+		// The queue is only left non-empty when the deadline expired
+		while (!queue.empty())
+			queue.pop();
+	}
+}
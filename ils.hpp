@@ -0,0 +1,12 @@
+#ifndef __ILS
+#define __ILS
+
+#include "Tour.hpp"
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "deadline.hpp"
+#include "random.hpp"
+
+void ils(Tour&, const Distance&, const Candidates&, Random&, const Deadline&);
+
+#endif
@@ -0,0 +1,113 @@
+#include "indexed_heap.hpp"
+
+/// Creates an empty heap for the items [0, n).
+IndexedHeap::IndexedHeap(int n) : _where(n, -1), _key(n) {
+	_heap.reserve(n);
+}
+
+/// Returns true if there are no items in the heap.
+bool IndexedHeap::empty() const {
+	return _heap.empty();
+}
+
+/// Returns the number of items in the heap.
+int IndexedHeap::size() const {
+	return _heap.size();
+}
+
+/// Returns true if an item is in the heap.
+bool IndexedHeap::contains(int item) const {
+	return _where[item] != -1;
+}
+
+/// Returns the key of an item in the heap.
+double IndexedHeap::key(int item) const {
+	return _key[item];
+}
+
+/// Returns the item with the smallest key.
+int IndexedHeap::top() const {
+	return _heap[0];
+}
+
+/// Puts an item at a position in the heap.
+void IndexedHeap::place(int item, int i) {
+	_heap[i] = item;
+	_where[item] = i;
+}
+
+/// Moves the item at position i towards the root.
+void IndexedHeap::up(int i) {
+	int item = _heap[i];
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (_key[_heap[parent]] <= _key[item])
+			break;
+		place(_heap[parent], i);
+		i = parent;
+	}
+	place(item, i);
+}
+
+/// Moves the item at position i towards the leaves.
+void IndexedHeap::down(int i) {
+	int item = _heap[i];
+	int n = _heap.size();
+	while (true) {
+		int child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && _key[_heap[child + 1]] < _key[_heap[child]])
+			++child;
+		if (_key[item] <= _key[_heap[child]])
+			break;
+		place(_heap[child], i);
+		i = child;
+	}
+	place(item, i);
+}
+
+/// Inserts an item, or changes its key if it is already in the heap.
+/// @param item The item
+/// @param key The new key of the item
+/// @complexity O(log n)
+void IndexedHeap::push(int item, double key) {
+	if (_where[item] == -1) {
+		_heap.push_back(item);
+		_where[item] = _heap.size() - 1;
+		_key[item] = key;
+		up(_where[item]);
+		return;
+	}
+	double old = _key[item];
+	_key[item] = key;
+	if (key < old)
+		up(_where[item]);
+	else
+		down(_where[item]);
+}
+
+/// Removes the item with the smallest key.
+/// @return The removed item
+/// @complexity O(log n)
+int IndexedHeap::pop() {
+	int item = _heap[0];
+	remove(item);
+	return item;
+}
+
+/// Removes an item from the heap, if it is in the heap.
+/// @complexity O(log n)
+void IndexedHeap::remove(int item) {
+	int i = _where[item];
+	if (i == -1)
+		return;
+	_where[item] = -1;
+	int last = _heap.back();
+	_heap.pop_back();
+	if (last == item)
+		return;
+	place(last, i);
+	up(i);
+	down(_where[last]);
+}
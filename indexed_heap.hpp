@@ -0,0 +1,30 @@
+#ifndef __INDEXED_HEAP
+#define __INDEXED_HEAP
+
+#include <vector>
+
+/// A binary min-heap of the integers [0, n), each with a key. The
+/// position of every item in the heap is tracked, so that the key of
+/// an item can be changed, or the item removed, in O(log n).
+class IndexedHeap {
+	std::vector<int> _heap;		// The items in heap order
+	std::vector<int> _where;	// Position of an item in _heap, -1 if absent
+	std::vector<double> _key;
+
+	void place(int, int);
+	void up(int);
+	void down(int);
+
+	public:
+	IndexedHeap(int);
+	bool empty() const;
+	int size() const;
+	bool contains(int) const;
+	double key(int) const;
+	int top() const;
+	void push(int, double);
+	int pop();
+	void remove(int);
+};
+
+#endif
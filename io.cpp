@@ -0,0 +1,328 @@
+#include "io.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+static const char MAGIC[4] = { 'T', 'S', 'P', 'B' };
+static const char TOUR_MAGIC[4] = { 'T', 'S', 'P', 'T' };
+static const unsigned BINARY_VERSION = 1;
+// The size of the blocks read when the input cannot be mapped
+static const size_t BLOCK = 1 << 20;
+
+/// The contents of an input file, either mapped into memory or read
+/// into a buffer.
+class Input {
+	char *_data;
+	size_t _size;
+	bool _mapped;
+
+	public:
+	/// Maps a regular file into memory, or reads a pipe in blocks.
+	Input(int fd) : _data(nullptr), _size(0), _mapped(false) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				_data = static_cast<char*>(p);
+				_size = st.st_size;
+				_mapped = true;
+				madvise(p, _size, MADV_SEQUENTIAL);
+				return;
+			}
+		}
+		size_t capacity = 0;
+		while (true) {
+			if (_size + BLOCK > capacity) {
+				capacity = 2 * capacity + BLOCK;
+				char *grown = static_cast<char*>(realloc(_data, capacity));
+				if (!grown)
+					throw std::bad_alloc();
+				_data = grown;
+			}
+			ssize_t n = read(fd, _data + _size, BLOCK);
+			if (n == 0)
+				break;
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error("cannot read the input");
+			}
+			_size += n;
+		}
+	}
+
+	~Input() {
+		if (_mapped)
+			munmap(_data, _size);
+		else
+			free(_data);
+	}
+
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	const char* begin() const {
+		return _data;
+	}
+
+	const char* end() const {
+		return _data + _size;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+};
+
+/// A parser for whitespace separated numbers in a character range.
+class Parser {
+	const char *_p;
+	const char *_end;
+
+	void skip_space() {
+		while (_p < _end && (*_p == ' ' || *_p == '\n' || *_p == '\t' || *_p == '\r'))
+			++_p;
+	}
+
+	public:
+	Parser(const char *begin, const char *end) : _p(begin), _end(end) {}
+
+	/// Parses a non-negative integer.
+	long integer() {
+		skip_space();
+		if (_p == _end || *_p < '0' || *_p > '9')
+			throw std::runtime_error("expected the number of cities");
+		long value = 0;
+		while (_p < _end && *_p >= '0' && *_p <= '9')
+			value = 10 * value + (*_p++ - '0');
+		return value;
+	}
+
+	/// Parses a decimal number. Numbers with at most 15 significant
+	/// digits and a small exponent are computed exactly from an integer
+	/// mantissa and a power of ten, others are handed to strtod.
+	double real() {
+		static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+			1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+			1e21, 1e22 };
+		skip_space();
+		const char *start = _p;
+		bool negative = false;
+		if (_p < _end && (*_p == '-' || *_p == '+'))
+			negative = *_p++ == '-';
+		unsigned long long mantissa = 0;
+		int digits = 0, scale = 0;
+		bool any = false;
+		for (; _p < _end && *_p >= '0' && *_p <= '9'; ++_p, any = true) {
+			if (mantissa == 0 && *_p == '0')
+				continue; // Leading zeros are not significant
+			if (digits < 19) {
+				mantissa = 10 * mantissa + (*_p - '0');
+				++digits;
+			} else {
+				++scale;
+			}
+		}
+		if (_p < _end && *_p == '.') {
+			for (++_p; _p < _end && *_p >= '0' && *_p <= '9'; ++_p, any = true) {
+				if (mantissa == 0 && *_p == '0') {
+					--scale;
+					continue;
+				}
+				if (digits < 19) {
+					mantissa = 10 * mantissa + (*_p - '0');
+					++digits;
+					--scale;
+				}
+			}
+		}
+		if (!any)
+			throw std::runtime_error("expected a coordinate");
+		bool exact = digits <= 15;
+		if (_p < _end && (*_p == 'e' || *_p == 'E')) {
+			// Rare, let strtod deal with exponents
+			exact = false;
+			++_p;
+			if (_p < _end && (*_p == '-' || *_p == '+'))
+				++_p;
+			while (_p < _end && *_p >= '0' && *_p <= '9')
+				++_p;
+		}
+		if (exact && scale >= -22 && scale <= 22) {
+			double value = static_cast<double>(mantissa);
+			value = scale < 0 ? value / POW10[-scale] : value * POW10[scale];
+			return negative ? -value : value;
+		}
+		// The input need not be null terminated, so copy the number
+		char buffer[128];
+		size_t length = std::min<size_t>(_p - start, sizeof(buffer) - 1);
+		memcpy(buffer, start, length);
+		buffer[length] = '\0';
+		return strtod(buffer, nullptr);
+	}
+};
+
+/// Reads the coordinates of a binary instance.
+static void read_binary(const Input &input, std::vector<City> &cities) {
+	BinaryHeader header;
+	memcpy(&header, input.begin(), sizeof(header));
+	if (header.version != BINARY_VERSION ||
+			(header.element != sizeof(float) && header.element != sizeof(double)))
+		throw std::runtime_error("unsupported binary instance");
+	// The size comes from the file, check it before multiplying
+	if (header.size > INT_MAX)
+		throw std::runtime_error("too many cities in binary instance");
+	size_t n = header.size;
+	if (n > (input.size() - sizeof(header)) / (2 * header.element))
+		throw std::runtime_error("truncated binary instance");
+	const char *xs = input.begin() + sizeof(header);
+	const char *ys = xs + n * header.element;
+	cities.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		City &c = cities[i];
+		if (header.element == sizeof(double)) {
+			memcpy(&c.x, xs + i * sizeof(double), sizeof(double));
+			memcpy(&c.y, ys + i * sizeof(double), sizeof(double));
+		} else {
+			float x, y;
+			memcpy(&x, xs + i * sizeof(float), sizeof(float));
+			memcpy(&y, ys + i * sizeof(float), sizeof(float));
+			c.x = x;
+			c.y = y;
+		}
+		c.name = i;
+	}
+}
+
+/// Reads an instance, which is either text or binary. A text instance
+/// holds the number of cities followed by the coordinates of each
+/// city. A binary instance starts with a BinaryHeader. Regular files
+/// are mapped into memory, other input is read in large blocks, and
+/// the numbers are parsed without going through iostreams.
+/// @param fd The file descriptor to read from
+/// @param cities The cities read (output)
+/// @complexity O(n)
+void read_instance(int fd, std::vector<City> &cities) {
+	Input input(fd);
+	if (input.size() >= sizeof(BinaryHeader) && memcmp(input.begin(), MAGIC, 4) == 0) {
+		read_binary(input, cities);
+		return;
+	}
+	Parser parser(input.begin(), input.end());
+	long size = parser.integer();
+	cities.resize(size);
+	for (long i = 0; i < size; ++i) {
+		City &c = cities[i];
+		c.x = parser.real();
+		c.y = parser.real();
+		c.name = i;
+	}
+}
+
+/// Reads the instance given on standard input.
+void read_input(std::vector<City> &cities) {
+	read_instance(STDIN_FILENO, cities);
+}
+
+/// Writes an instance in the binary format.
+/// @param path The file to write
+/// @param cities The cities
+/// @param single Store the coordinates as float rather than double
+void write_instance(const std::string &path, const std::vector<City> &cities, bool single) {
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f)
+		throw std::runtime_error("cannot open " + path);
+	BinaryHeader header;
+	memcpy(header.magic, MAGIC, 4);
+	header.version = BINARY_VERSION;
+	header.element = single ? sizeof(float) : sizeof(double);
+	header.reserved = 0;
+	header.size = cities.size();
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (int axis = 0; axis < 2; ++axis) {
+		for (size_t i = 0; i < cities.size(); ++i) {
+			double value = axis == 0 ? cities[i].x : cities[i].y;
+			float narrow = value;
+			ok = ok && (single ? fwrite(&narrow, sizeof(float), 1, f)
+			                   : fwrite(&value, sizeof(double), 1, f)) == 1;
+		}
+	}
+	if (fclose(f) != 0 || !ok)
+		throw std::runtime_error("cannot write " + path);
+}
+
+/// Writes all of a buffer, retrying on partial writes.
+static void write_all(int fd, const char *data, size_t size) {
+	while (size > 0) {
+		ssize_t n = write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("cannot write the tour");
+		}
+		data += n;
+		size -= n;
+	}
+}
+
+/// Formats a non-negative integer followed by a newline.
+/// @return The position after the newline
+static char* format_line(char *p, long value) {
+	char digits[24];
+	int n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+	while (n > 0)
+		*p++ = digits[--n];
+	*p++ = '\n';
+	return p;
+}
+
+/// Writes a tour. The whole output is formatted into one buffer, which
+/// is written with as few system calls as possible.
+/// @param fd The file descriptor to write to
+/// @param t The tour
+/// @param format The output format
+/// @param names The id to write for each city, or nullptr to write
+///        the cities as they are numbered in the tour
+/// @complexity O(n)
+void write_tour(int fd, const Tour &t, TourFormat format, const int *names) {
+	int size = t.size();
+	if (format == BINARY) {
+		BinaryHeader header;
+		memcpy(header.magic, TOUR_MAGIC, 4);
+		header.version = BINARY_VERSION;
+		header.element = sizeof(int);
+		header.reserved = 0;
+		header.size = size;
+		std::vector<char> buffer(sizeof(header) + static_cast<size_t>(size) * sizeof(int));
+		memcpy(buffer.data(), &header, sizeof(header));
+		for (int i = 0; i < size; ++i) {
+			int city = names ? names[t[i]] : t[i];
+			memcpy(buffer.data() + sizeof(header) + i * sizeof(int), &city, sizeof(int));
+		}
+		write_all(fd, buffer.data(), buffer.size());
+		return;
+	}
+
+	// At most 10 digits and a newline per city, plus the TSPLIB lines
+	std::vector<char> buffer(11 * static_cast<size_t>(size) + 128);
+	char *p = buffer.data();
+	if (format == TSPLIB)
+		p += sprintf(p, "NAME : tour\nTYPE : TOUR\nDIMENSION : %d\nTOUR_SECTION\n", size);
+	for (int i = 0; i < size; ++i)
+		p = format_line(p, (names ? names[t[i]] : t[i]) + (format == TSPLIB));
+	if (format == TSPLIB)
+		p += sprintf(p, "-1\nEOF\n");
+	write_all(fd, buffer.data(), p - buffer.data());
+}
@@ -0,0 +1,31 @@
+#ifndef __IO
+#define __IO
+
+#include "main.hpp"
+#include "Tour.hpp"
+#include <vector>
+#include <string>
+
+/// The header of a binary instance. It is followed by the x-coordinates
+/// of all cities and then by their y-coordinates, as 64-bit or 32-bit
+/// IEEE floats in the byte order of the machine which wrote the file.
+struct BinaryHeader {
+	char magic[4];			// "TSPB"
+	unsigned version;		// BINARY_VERSION
+	unsigned element;		// sizeof(float) or sizeof(double)
+	unsigned reserved;
+	unsigned long long size;	// The number of cities
+};
+
+/// The formats a tour can be written in.
+enum TourFormat {
+	TEXT,		// One city per line
+	BINARY,		// A BinaryHeader with the magic "TSPT", then 32-bit cities
+	TSPLIB		// A TSPLIB .tour file, with cities numbered from 1
+};
+
+void read_instance(int, std::vector<City>&);
+void write_tour(int, const Tour&, TourFormat = TEXT, const int* = nullptr);
+void write_instance(const std::string&, const std::vector<City>&, bool = false);
+
+#endif
@@ -0,0 +1,244 @@
+#include "kdtree.hpp"
+#include <algorithm>
+
+// Ranges of at most this many points are not split further
+static const int BUCKET = 8;
+
+KDTree::~KDTree() {
+	delete[] _x;
+	delete[] _y;
+	delete[] _id;
+	delete[] _dim;
+	delete[] _live;
+	delete[] _pos;
+	delete[] _gone;
+}
+
+/// Builds a balanced k-d tree over the cities specified.
+/// @param cities The cities to index
+/// @complexity O(n log n)
+KDTree::KDTree(const std::vector<City> &cities) {
+	_size = cities.size();
+	_x = new double[_size];
+	_y = new double[_size];
+	_id = new int[_size];
+	_dim = new char[_size];
+	_live = new int[_size];
+	_pos = new int[_size];
+	_gone = new char[_size];
+	// Build using coordinates indexed by city, then
+	// store them in tree order for locality.
+	for (int i = 0; i < _size; ++i) {
+		_x[i] = cities.at(i).x;
+		_y[i] = cities.at(i).y;
+		_id[i] = i;
+		_dim[i] = 0;
+		_gone[i] = false;
+	}
+	if (_size > 0)
+		build(0, _size);
+	double *x = new double[_size];
+	double *y = new double[_size];
+	for (int i = 0; i < _size; ++i) {
+		x[i] = _x[_id[i]];
+		y[i] = _y[_id[i]];
+		_pos[_id[i]] = i;
+	}
+	delete[] _x;
+	delete[] _y;
+	_x = x;
+	_y = y;
+}
+
+/// Splits the range [lo, hi) along its widest dimension.
+void KDTree::build(int lo, int hi) {
+	_live[(lo + hi) / 2] = hi - lo;
+	if (hi - lo <= BUCKET)
+		return;
+	double min_x = _x[_id[lo]], max_x = min_x;
+	double min_y = _y[_id[lo]], max_y = min_y;
+	for (int i = lo + 1; i < hi; ++i) {
+		int c = _id[i];
+		min_x = std::min(min_x, _x[c]);
+		max_x = std::max(max_x, _x[c]);
+		min_y = std::min(min_y, _y[c]);
+		max_y = std::max(max_y, _y[c]);
+	}
+	char dim = max_x - min_x >= max_y - min_y ? 0 : 1;
+	const double *key = dim == 0 ? _x : _y;
+	int mid = (lo + hi) / 2;
+	std::nth_element(_id + lo, _id + mid, _id + hi, [key](int a, int b) {
+		return key[a] < key[b];
+	});
+	_dim[mid] = dim;
+	build(lo, mid);
+	build(mid + 1, hi);
+}
+
+/// Sets the number of cities left in the range [lo, hi) and in all
+/// ranges below it to their sizes.
+void KDTree::count(int lo, int hi) {
+	_live[(lo + hi) / 2] = hi - lo;
+	if (hi - lo <= BUCKET)
+		return;
+	int mid = (lo + hi) / 2;
+	count(lo, mid);
+	count(mid + 1, hi);
+}
+
+/// Puts back all removed cities, which is much cheaper than building
+/// a new tree.
+/// @complexity O(n)
+void KDTree::restore() {
+	for (int i = 0; i < _size; ++i)
+		_gone[i] = false;
+	if (_size > 0)
+		count(0, _size);
+}
+
+/// Returns the number of cities in the tree.
+int KDTree::size() const {
+	return _size;
+}
+
+/// Checks if the offset (dx, dy) lies in the given quadrant,
+/// numbered counter-clockwise starting with dx >= 0, dy >= 0.
+/// A negative quadrant matches everything.
+static inline bool in_quadrant(double dx, double dy, int quadrant) {
+	switch (quadrant) {
+		case 0: return dx >= 0 && dy >= 0;
+		case 1: return dx < 0 && dy >= 0;
+		case 2: return dx < 0 && dy < 0;
+		case 3: return dx >= 0 && dy < 0;
+		default: return true;
+	}
+}
+
+/// Checks if a quadrant may contain points on the given side of a
+/// splitting line. The low side has coordinates <= split, the high
+/// side has coordinates >= split.
+static inline bool may_contain(int quadrant, char dim, bool high, double offset) {
+	if (quadrant < 0)
+		return true;
+	// Sign of the coordinate required by the quadrant: +1 for >= 0
+	bool positive = dim == 0 ? (quadrant == 0 || quadrant == 3)
+	                         : (quadrant == 0 || quadrant == 1);
+	// offset is split minus query coordinate
+	if (positive && !high)
+		return offset >= 0;
+	if (!positive && high)
+		return offset < 0;
+	return true;
+}
+
+void KDTree::search(int lo, int hi, double qx, double qy, int exclude, int quadrant,
+		int k, int *ids, double *d2, int &count) const {
+	int mid = (lo + hi) / 2;
+	if (_live[mid] == 0)
+		return;
+	bool leaf = hi - lo <= BUCKET;
+	int from = leaf ? lo : mid;
+	int to = leaf ? hi : mid + 1;
+	for (int i = from; i < to; ++i) {
+		double dx = _x[i] - qx;
+		double dy = _y[i] - qy;
+		if (_gone[i] || _id[i] == exclude || !in_quadrant(dx, dy, quadrant))
+			continue;
+		double dist = dx*dx + dy*dy;
+		if (count == k && dist >= d2[k-1])
+			continue;
+		// Insert into the sorted result, dropping the farthest
+		int pos = count < k ? count++ : k - 1;
+		while (pos > 0 && d2[pos-1] > dist) {
+			d2[pos] = d2[pos-1];
+			ids[pos] = ids[pos-1];
+			--pos;
+		}
+		d2[pos] = dist;
+		ids[pos] = _id[i];
+	}
+	if (leaf)
+		return;
+
+	char dim = _dim[mid];
+	double offset = dim == 0 ? _x[mid] - qx : _y[mid] - qy;
+	bool high = offset <= 0; // The query lies on the high side
+	for (int side = 0; side < 2; ++side) {
+		bool h = side == 0 ? high : !high;
+		if (side == 1 && count == k && offset*offset >= d2[k-1])
+			return;
+		if (!may_contain(quadrant, dim, h, offset))
+			continue;
+		if (h)
+			search(mid + 1, hi, qx, qy, exclude, quadrant, k, ids, d2, count);
+		else
+			search(lo, mid, qx, qy, exclude, quadrant, k, ids, d2, count);
+	}
+}
+
+/// Finds the k cities closest to the point (x, y).
+/// @param x The x-coordinate of the query point
+/// @param y The y-coordinate of the query point
+/// @param exclude A city to skip, typically the query city itself
+/// @param k The maximum number of cities to return
+/// @param ids The closest cities in ascending order of distance (output)
+/// @param d2 The squared distances of the cities in ids (output)
+/// @param quadrant Only consider cities in this quadrant around (x, y)
+/// @return The number of cities found
+/// @complexity O(log n + k) expected
+int KDTree::nearest(double x, double y, int exclude, int k, int *ids,
+		double *d2, int quadrant) const {
+	int count = 0;
+	if (k > 0 && _size > 0)
+		search(0, _size, x, y, exclude, quadrant, k, ids, d2, count);
+	return count;
+}
+
+/// Removes a city from the tree, such that it is no longer returned
+/// by nearest().
+/// @param city The city to remove
+/// @complexity O(log n)
+void KDTree::remove(int city) {
+	int p = _pos[city];
+	if (_gone[p])
+		return;
+	_gone[p] = true;
+	// Update the counts of the ranges containing the city
+	int lo = 0, hi = _size;
+	while (true) {
+		int mid = (lo + hi) / 2;
+		--_live[mid];
+		if (hi - lo <= BUCKET || p == mid)
+			return;
+		if (p < mid)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+}
+
+LocalTrees::~LocalTrees() {
+	for (auto &tree : _trees)
+		delete tree.second;
+}
+
+/// Creates an empty set of trees. The cities must outlive the trees.
+LocalTrees::LocalTrees(const std::vector<City> &cities) : _cities(cities) {}
+
+/// Returns the tree of the calling thread, and builds it if the thread
+/// has none. The tree is built outside the lock, so that threads can
+/// build their trees at the same time.
+/// @complexity O(n log n) on the first call of a thread, O(1) after
+KDTree& LocalTrees::local() {
+	std::thread::id id = std::this_thread::get_id();
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		auto found = _trees.find(id);
+		if (found != _trees.end())
+			return *found->second;
+	}
+	KDTree *tree = new KDTree(_cities);
+	std::lock_guard<std::mutex> guard(_lock);
+	_trees[id] = tree;
+	return *tree;
+}
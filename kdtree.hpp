@@ -0,0 +1,57 @@
+#ifndef __KDTREE
+#define __KDTREE
+
+#include "main.hpp"
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/// A static two-dimensional k-d tree over the coordinates of a
+/// set of cities. The tree is stored implicitly in an array, such
+/// that the subtree of the range [lo, hi) is split by the point at
+/// (lo + hi) / 2. Small ranges are kept as buckets and scanned
+/// linearly. Cities can be removed from the tree, which keeps a count
+/// of the remaining cities in every range to skip empty subtrees.
+class KDTree {
+	double *_x;		// x-coordinates in tree order
+	double *_y;		// y-coordinates in tree order
+	int *_id;		// _id[i] is the city stored at tree position i
+	char *_dim;		// Split dimension of the range with median i
+	int *_live;		// Number of cities left in the range with median i
+	int *_pos;		// _pos[c] is the tree position of city c
+	char *_gone;	// The city at tree position i has been removed
+	int _size;
+
+	void build(int, int);
+	void count(int, int);
+	void search(int, int, double, double, int, int, int, int*, double*, int&) const;
+
+	public:
+	~KDTree();
+	KDTree(const std::vector<City>&);
+	KDTree(const KDTree&) = delete;
+	KDTree& operator=(const KDTree&) = delete;
+	int size() const;
+	int nearest(double, double, int, int, int*, double*, int = -1) const;
+	void remove(int);
+	void restore();
+};
+
+/// One k-d tree over a set of cities for every thread which asks for
+/// one. A tree is built the first time a thread asks, and is reused by
+/// that thread afterwards, so it should be restored after use.
+class LocalTrees {
+	const std::vector<City> &_cities;
+	std::mutex _lock;
+	std::unordered_map<std::thread::id, KDTree*> _trees;
+
+	public:
+	~LocalTrees();
+	LocalTrees(const std::vector<City>&);
+	LocalTrees(const LocalTrees&) = delete;
+	LocalTrees& operator=(const LocalTrees&) = delete;
+	KDTree& local();
+};
+
+#endif
@@ -5,61 +5,222 @@
 #include "nearest_insertion.hpp"
 #include "nearest_neighbour.hpp"
 #include "clarke_wright.hpp"
+#include "greedy.hpp"
+#include "hilbert.hpp"
+#include "construction.hpp"
+#include "candidates.hpp"
+#include "city_store.hpp"
+#include "distance.hpp"
+#include "deadline.hpp"
+#include "anytime.hpp"
+#include "multistart.hpp"
+#include "memetic.hpp"
+#include "parallel_opt2.hpp"
+#include "random.hpp"
+#include "io.hpp"
 
 #include <iostream>
 #include <unordered_set>
 #include <vector>
+#include <string>
+#include <memory>
 #include <cstdio>
 #include <cmath>
 #include <ctime>
 #include <iomanip>
 #include <algorithm>
 #include <cstddef>
-#include <cfloat>
 #include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
 
-void read_input(std::vector<City> &cities) {
-	int size;
-	std::cin >> size;
-	cities.reserve(size);
-	for (int i = 0; i < size; ++i) {
-		City city;
-		city.name = i;
-		std::cin >> city.x;
-		std::cin >> city.y;
-		cities.push_back(city);
+typedef std::chrono::steady_clock Clock;
+
+// Time reserved for printing the tour in time limited mode, the
+// second term is the time needed per city.
+const double OUTPUT_TIME = 0.02;
+const double OUTPUT_TIME_PER_CITY = 2e-7;
+// Time needed per byte of the distance matrix to give its pages back
+// to the system when the process exits
+const double RELEASE_TIME_PER_BYTE = 1e-10;
+// Rough time needed per pair of cities to fill the dense matrix
+const double DENSE_TIME_PER_PAIR = 2e-8;
+// In time limited mode, the dense matrix is only built if it takes at
+// most this share of the time left, otherwise distances are computed
+// on the fly
+const double DENSE_SHARE = 0.25;
+// Rough time per city needed to build the candidate lists and a greedy
+// tour. If this and the time for the dense matrix, when one is built,
+// do not fit in the time left, the space filling curve tour is used.
+const double SETUP_TIME_PER_CITY = 3e-6;
+// Instance sizes for which recombining tours improved in parallel beats
+// kicking a single tour in time limited mode
+const size_t MEMETIC_MIN = 1000;
+const size_t MEMETIC_MAX = 20000;
+
+// The construction heuristics which can be selected by name
+const char *CONSTRUCTIONS[] = { "nn", "cw", "greedy", "hilbert", "ni", "fi", "ci", "ri", "mst" };
+const int CONSTRUCTION_COUNT = sizeof(CONSTRUCTIONS) / sizeof(CONSTRUCTIONS[0]);
+
+// The construction heuristics which always build the same tour
+const char *DETERMINISTIC[] = { "greedy", "hilbert" };
+const int DETERMINISTIC_COUNT = sizeof(DETERMINISTIC) / sizeof(DETERMINISTIC[0]);
+
+// The tour output formats, in the order of TourFormat
+const char *FORMATS[] = { "text", "binary", "tsplib" };
+const int FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+void usage(const char *name) {
+	std::cerr << "Usage: " << name << " [--time-limit SECONDS] [--seed SEED]"
+		<< " [--threads THREADS] [--write-instance FILE] [--construction";
+	for (int i = 0; i < CONSTRUCTION_COUNT; ++i)
+		std::cerr << (i == 0 ? " " : "|") << CONSTRUCTIONS[i];
+	std::cerr << "] [--output";
+	for (int i = 0; i < FORMAT_COUNT; ++i)
+		std::cerr << (i == 0 ? " " : "|") << FORMATS[i];
+	std::cerr << "] < INSTANCE" << std::endl;
+}
+
+/// Returns the construction heuristic with the given name, or an
+/// empty function if there is no such heuristic.
+Construction construction(const std::string &name, const std::vector<City> &cities,
+		const Distance &d, const Candidates &cand, const Deadline &deadline) {
+	if (name == "nn") {
+		// Every thread builds its tree once, it is restored after each
+		// tour
+		std::shared_ptr<LocalTrees> trees(new LocalTrees(cities));
+		return [&cities, deadline, trees](Random &rng) {
+			return nearest_neighbour(cities, trees->local(), rng, deadline);
+		};
+	}
+	if (name == "cw") {
+		return [&cities, &d, &cand](Random &rng) {
+			return clarke_wright(cities, d, cand, rng);
+		};
 	}
+	if (name == "greedy") {
+		return [&cities, &cand](Random&) {
+			return greedy(cities, cand);
+		};
+	}
+	if (name == "hilbert") {
+		return [&cities](Random&) {
+			return hilbert(cities);
+		};
+	}
+	if (name == "ni" || name == "fi" || name == "ci" || name == "ri") {
+		Tour* (*insertion)(const std::vector<City>&, const Candidates&, Random&) =
+			name == "ni" ? nearest_insertion : name == "fi" ? farthest_insertion :
+			name == "ci" ? cheapest_insertion : random_insertion;
+		return [&cities, &cand, insertion](Random &rng) {
+			return insertion(cities, cand, rng);
+		};
+	}
+	if (name == "mst") {
+		// The tree is only built when the heuristic is used, and is
+		// shared by all tours built from it
+		std::vector<int> parent(cities.size());
+		mst(cities, cand, parent.data());
+		std::shared_ptr<MSTTours> tours(new MSTTours(parent.data(), parent.size()));
+		return [tours](Random &rng) {
+			return (*tours)(rng);
+		};
+	}
+	return Construction();
 }
 
-int min(int a, int b) {
-	return a < b ? a : b;
+/// Parses a non-negative number given as a command line argument.
+/// @return False if the argument is not a number
+bool parse_number(const char *arg, double &value) {
+	char *end;
+	value = strtod(arg, &end);
+	return end != arg && *end == '\0' && value >= 0;
 }
 
-Tour* best_solution(std::vector<Tour*> &tours, double **d) {
-	Tour* best = nullptr;
-	double min = DBL_MAX;
-	for (size_t i = 0; i < tours.size(); ++i) {
-		double next_distance = tours.at(i)->length(d);
-		if (next_distance < min) {
-			min = next_distance;
-			best = tours.at(i);
+/// Parses a non-negative integer given as a command line argument.
+/// @param max The largest value allowed
+/// @return False if the argument is not an integer from 0 to max
+bool parse_integer(const char *arg, unsigned long max, unsigned long &value) {
+	char *end;
+	errno = 0;
+	value = strtoul(arg, &end, 10);
+	// strtoul skips whitespace and negates numbers with a minus sign
+	return isdigit(static_cast<unsigned char>(arg[0])) && *end == '\0' && errno == 0 &&
+		value <= max;
+}
+
+int main(int argc, char *argv[]) {
+	// The clock starts before anything else is done
+	Clock::time_point start = Clock::now();
+	double time_limit = -1;
+	unsigned seed = time(NULL);
+	int threads = 0; // All cores
+	std::string heuristic; // Depends on the mode if not given
+	std::string instance_file; // Convert the input to a binary instance
+	TourFormat format = TEXT;
+	for (int i = 1; i < argc; ++i) {
+		unsigned long value;
+		if (strcmp(argv[i], "--write-instance") == 0 && i + 1 < argc) {
+			instance_file = argv[++i];
+			continue;
+		} else if (strcmp(argv[i], "--construction") == 0 && i + 1 < argc) {
+			heuristic = argv[++i];
+			if (std::find(CONSTRUCTIONS, CONSTRUCTIONS + CONSTRUCTION_COUNT, heuristic)
+					!= CONSTRUCTIONS + CONSTRUCTION_COUNT)
+				continue;
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			const char **f = std::find_if(FORMATS, FORMATS + FORMAT_COUNT,
+				[&](const char *name) { return strcmp(name, argv[i + 1]) == 0; });
+			if (f != FORMATS + FORMAT_COUNT) {
+				format = static_cast<TourFormat>(f - FORMATS);
+				++i;
+				continue;
+			}
+		} else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+			if (parse_number(argv[++i], time_limit))
+				continue;
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			if (parse_integer(argv[++i], UINT_MAX, value)) {
+				seed = value;
+				continue;
+			}
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			if (parse_integer(argv[++i], INT_MAX, value)) {
+				threads = value;
+				continue;
+			}
 		}
+		usage(argv[0]);
+		return 1;
 	}
-	return best;
-}
 
-int main() {
 	// Disable syncing with C printf and scanf
 	std::ios_base::sync_with_stdio(false);
 	// Initialize the PRNG
-	srand(time(NULL));
+	Random rng(seed);
 	
 	std::vector<City> cities;
-	read_input(cities);
+	try {
+		read_input(cities);
+		if (!instance_file.empty()) {
+			write_instance(instance_file, cities);
+			return 0;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		return 1;
+	}
 	
-	double **dist = pre_dist(cities);			// Distance matrix
-	int *tree = new int[cities.size()];			// Minimum spanning tree
-	mst(dist, cities.size(), tree);
+	// Renumber the cities along a Hilbert curve, so that cities close in
+	// the plane are close in memory. The tour is printed with the
+	// original ids.
+	CityStore store(cities, true);
+	store.write(cities);
 	
 	if (cities.size() < 4) {
 		int n = cities.size();
@@ -67,86 +228,98 @@ int main() {
 		for (int i = 0; i < n; ++i)
 			tour[i] = i;
 		Tour t(tour, n);
-		t.print();
+		write_tour(STDOUT_FILENO, t, format, store.ids());
 		return 0;
 	}
 	
-	// Will contain a set of candidate solutions
-	std::vector<Tour*> tours;
+	// The time needed for output, which is reserved in time limited mode
+	double output_time = OUTPUT_TIME + OUTPUT_TIME_PER_CITY * cities.size();
+	Distance::Mode mode = Distance::AUTO;
+	if (time_limit > 0) {
+		// Building the dense matrix takes O(n^2) time, which must fit
+		// in the time limit along with the search
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		double left = time_limit - elapsed - output_time;
+		double pairs = 0.5 * cities.size() * cities.size();
+		double matrix_time = DENSE_TIME_PER_PAIR * pairs + RELEASE_TIME_PER_BYTE *
+			Distance::bytes(cities.size(), Distance::FLOAT, Distance::SQUARE);
+		if (matrix_time > DENSE_SHARE * left) {
+			mode = Distance::ON_THE_FLY;
+			matrix_time = 0;
+		}
+		// Decide before anything expensive is built
+		if (left < SETUP_TIME_PER_CITY * cities.size() + matrix_time) {
+			Tour *t = hilbert(cities);
+			write_tour(STDOUT_FILENO, *t, format, store.ids());
+			return 0;
+		}
+	}
+	Distance dist(store, mode, Distance::FLOAT); // Distance provider
 	
+	if (time_limit > 0) {
+		// Run until the time limit, minus the time needed for output
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		double reserve = output_time + RELEASE_TIME_PER_BYTE * dist.bytes();
+		Deadline deadline(std::max(0.0, time_limit - elapsed - reserve));
+		Candidates cand(cities, 10);
+		// Large instances only have time for a few restarts, so they
+		// start from a single greedy tour, which is better than any
+		// nearest neighbour tour
+		if (heuristic.empty())
+			heuristic = cities.size() <= 700 ? "nn" : "greedy";
+		bool randomized = std::find(DETERMINISTIC, DETERMINISTIC + DETERMINISTIC_COUNT,
+			heuristic) == DETERMINISTIC + DETERMINISTIC_COUNT;
+		Construction construct = construction(heuristic, cities, dist, cand, deadline);
+		// Recombination collects the improvements found in parallel, on a
+		// single core the time is better spent on one tour
+		int cores = threads > 0 ? threads : std::thread::hardware_concurrency();
+		Tour *best = cores > 1 && cities.size() >= MEMETIC_MIN && cities.size() <= MEMETIC_MAX ?
+			memetic(construct, dist, cand, seed, threads, deadline) :
+			anytime(construct, dist, cand, rng, deadline, randomized);
+		write_tour(STDOUT_FILENO, *best, format, store.ids());
+		return 0;
+	}
+
 	// Determine parameters
 	// nn_count - The number of tours created using nearest neighbour
-	// ni_count - The number of tours created using nearest insertion
-	// mst_count - The number of tours created using MST heuristic
-	// k2l - The size of the neighbourhood used by opt2k
-	// k2g - The number of global 2-Opt moves which should be applied
-	int nn_count, ni_count, mst_count, k2l, k2g;
+	// k - The length of the candidate lists used by local search
+	int nn_count, k = 10;
 	if (cities.size() <= 50) {
 		nn_count = 1000;
-		ni_count = 2000;
-		mst_count = 1000;
-		k2l = 0;
-		k2g = INT_MAX;
 	} else if (cities.size() <= 100) {
 		nn_count = 200;
-		ni_count = 300;
-		mst_count = 100;
-		k2l = 0;
-		k2g = INT_MAX;
 	} else if (cities.size() <= 200) {
 		nn_count = 30;
-		ni_count = 50;
-		mst_count = 40;
-		k2l = 0;
-		k2g = 70;
 	} else if (cities.size() <= 300) {
-		nn_count = 1;
-		ni_count = 2;
-		mst_count = 0;
-		k2l = 20;
-		k2g = 10;
+		nn_count = 10;
 	} else if (cities.size() <= 500) {
-		nn_count = 0;
-		ni_count = 1;
-		mst_count = 0;
-		k2l = 0;
-		k2g = 198;
+		nn_count = 5;
 	} else if (cities.size() <= 700) {
-		nn_count = 0;
-		ni_count = 1;
-		mst_count = 0;
-		k2l = 0;
-		k2g = 192;
+		nn_count = 3;
 	} else {
-		nn_count = 0;
-		ni_count = 1;
-		mst_count = 0;
-		k2l = 0;
-		k2g = 190;
-	}
-	
-	// Create candidate solutions
-	for (int i = 0; i < nn_count; ++i) {
-		Tour *t = nearest_neighbour(dist, cities.size());
-		tours.push_back(t);
+		nn_count = 1;
 	}
-	//for (int i = 0; i < ni_count; ++i) {
-		//Tour *t = nearest_insertion(dist, cities.size());
-		//tours.push_back(t);
-	//}
-	//for (int i = 0; i < mst_count; ++i) {
-		//Tour *t = mst_heuristic(tree, cities.size());
-		//tours.push_back(t);
-	//}
 	
-	// Improve the solutions using local search
-	for (auto i = tours.begin(); i != tours.end(); ++i) {
-		//opt2k(cities, **i, dist, k2l, INT_MAX);
-		//opt2(**i, dist, k2g); 
-		opt3(**i, dist, INT_MAX); 
+	// Candidate lists for the neighbourhood searches
+	Candidates cand(cities, k);
+
+	if (nn_count == 1) {
+		// A single large tour, start from the greedy tour unless told
+		// otherwise and bring it to a 2-Opt local optimum on all cores
+		// before the serial Lin-Kernighan
+		Tour *t = construction(heuristic.empty() ? "greedy" : heuristic, cities, dist, cand,
+			Deadline())(rng);
+		parallel_opt2(*t, dist, cand, threads);
+		lin_kernighan(*t, dist, cand, INT_MAX);
+		write_tour(STDOUT_FILENO, *t, format, store.ids());
+		return 0;
 	}
-	
-	// Select and print the best solution
-	Tour *best = best_solution(tours, dist);
-	best->print();
+
+	// Create candidate solutions, improve them using local search and
+	// keep the best one. Nearest neighbour starts in a random city, which
+	// gives different tours to choose from.
+	Construction construct = construction(heuristic.empty() ? "nn" : heuristic, cities, dist,
+		cand, Deadline());
+	Tour *best = multistart(construct, dist, cand, nn_count, seed, threads);
+	write_tour(STDOUT_FILENO, *best, format, store.ids());
 }
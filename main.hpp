@@ -28,6 +28,5 @@ struct City {
 };
 
 void read_input(std::vector<City>&);
-Tour* best_solution(std::vector<Tour>&, double**);
 
 #endif
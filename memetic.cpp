@@ -0,0 +1,295 @@
+#include "memetic.hpp"
+#include "tsptools.hpp"
+#include "ils.hpp"
+#include "union_find.hpp"
+#include "tour_pool.hpp"
+#include "random.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// The number of members when there are fewer threads
+static const int MIN_MEMBERS = 2;
+// The number of epochs of iterated local search and recombination
+static const int EPOCHS = 20;
+// Stop the local search this many times the time of the last merge
+// before the deadline, so that the merge finishes in time
+static const double MERGE_MARGIN = 2;
+
+// Relative improvements smaller than this are rounding errors in the
+// sums of edge lengths, and are treated as zero
+static const double EPS = 1e-9;
+
+/// A fixed set of threads which run batches of work. The threads are
+/// started once, so the thread local scratch memory of the local search
+/// and the tour pools is reused by every batch. The calling thread also
+/// works on each batch.
+class Workers {
+	std::vector<std::thread> _threads;
+	std::mutex _lock;
+	std::condition_variable _start;	// A batch was started, or stop was set
+	std::condition_variable _done;	// The last thread finished a batch
+	std::function<void(int)> _job;
+	std::atomic<int> _next;			// The next index to hand out
+	int _count;						// The number of indices in the batch
+	int _batch;						// Counts the batches started
+	int _busy;						// Threads still working on the batch
+	bool _stop;
+
+	/// Calls the job for indices from the shared counter until there
+	/// are none left.
+	void work() {
+		int i;
+		while ((i = _next++) < _count)
+			_job(i);
+	}
+
+	/// Waits for batches and works on them until stopped.
+	void loop() {
+		int seen = 0;
+		std::unique_lock<std::mutex> guard(_lock);
+		while (true) {
+			_start.wait(guard, [&] { return _stop || _batch != seen; });
+			if (_stop)
+				return;
+			seen = _batch;
+			guard.unlock();
+			work();
+			guard.lock();
+			if (--_busy == 0)
+				_done.notify_one();
+		}
+	}
+
+	public:
+	Workers(int threads) : _next(0), _count(0), _batch(0), _busy(0), _stop(false) {
+		for (int i = 1; i < threads; ++i)
+			_threads.push_back(std::thread(&Workers::loop, this));
+	}
+
+	~Workers() {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_stop = true;
+		}
+		_start.notify_all();
+		for (size_t i = 0; i < _threads.size(); ++i)
+			_threads[i].join();
+	}
+
+	/// Calls f(i) for every i in [0, count), and returns when all calls
+	/// have finished. The indices are handed out one at a time.
+	void run(int count, const std::function<void(int)> &f) {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_job = f;
+			_count = count;
+			_next = 0;
+			_busy = _threads.size();
+			++_batch;
+		}
+		_start.notify_all();
+		work();
+		std::unique_lock<std::mutex> guard(_lock);
+		_done.wait(guard, [&] { return _busy == 0; });
+	}
+};
+
+/// Partition crossover (GPX). The union of the edges of two tours is
+/// split into components by removing the edges the tours share. The
+/// paths of shared edges are contracted, so a shared path which leaves
+/// a component and comes back to it stays inside the component. When a
+/// component is connected to the rest by exactly two shared paths, both
+/// tours pass through it as a single path between the same two cities,
+/// so the path of either tour can be used. The child takes the
+/// shorter path of every such component, and keeps the first tour
+/// everywhere else. The shared edges are never rebuilt, and only the
+/// cities of the replaced components are activated for the local
+/// search which repairs the joints.
+/// @param a The first parent, which the child is based on
+/// @param b The second parent
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param deadline Stop the local search when this deadline has expired
+/// @return The child, or nullptr if it would equal the first parent
+/// @complexity O(n α(n)) plus the local search
+static Tour* gpx(const Tour &a, const Tour &b, const Distance &d, const Candidates &cand,
+		const Deadline &deadline) {
+	int n = a.size();
+	// The two tour neighbours of every city in each parent
+	std::vector<int> an(2 * n), bn(2 * n);
+	for (int v = 0; v < n; ++v) {
+		an[2*v] = a.next(v);
+		an[2*v+1] = a.prev(v);
+		bn[2*v] = b.next(v);
+		bn[2*v+1] = b.prev(v);
+	}
+	auto in_a = [&](int v, int w) { return an[2*v] == w || an[2*v+1] == w; };
+	auto in_b = [&](int v, int w) { return bn[2*v] == w || bn[2*v+1] == w; };
+
+	// Components of the edges which are not shared
+	UnionFind uf(n);
+	std::vector<char> differs(n, false);
+	for (int v = 0; v < n; ++v) {
+		for (int k = 0; k < 2; ++k) {
+			if (!in_b(v, an[2*v+k])) {
+				differs[v] = true;
+				uf.unite(v, an[2*v+k]);
+			}
+			if (!in_a(v, bn[2*v+k])) {
+				differs[v] = true;
+				uf.unite(v, bn[2*v+k]);
+			}
+		}
+	}
+
+	// The shared paths leaving each component, and the length of the
+	// paths of both parents inside it, counted from both ends
+	std::vector<int> cut(n, 0);
+	std::vector<double> length_a(n, 0), length_b(n, 0);
+	for (int v = 0; v < n; ++v) {
+		if (!differs[v])
+			continue;
+		int c = uf.find(v);
+		for (int k = 0; k < 2; ++k) {
+			int w = an[2*v+k];
+			if (!in_b(v, w)) {
+				length_a[c] += d(v, w);
+			} else {
+				// Follow the shared path to the next city in a component
+				int from = v;
+				while (!differs[w]) {
+					int next = an[2*w] != from ? an[2*w] : an[2*w+1];
+					from = w;
+					w = next;
+				}
+				if (uf.find(w) != c)
+					++cut[c];
+			}
+			w = bn[2*v+k];
+			if (!in_a(v, w))
+				length_b[c] += d(v, w);
+		}
+	}
+	std::vector<char> take_b(n, false);
+	bool any = false;
+	for (int v = 0; v < n; ++v) {
+		if (differs[v] && uf.find(v) == v && (cut[v] == 0 || cut[v] == 2) &&
+				length_b[v] < length_a[v] * (1 - EPS)) {
+			take_b[v] = true;
+			any = true;
+		}
+	}
+	if (!any)
+		return nullptr;
+
+	// Walk the child, which follows b in the chosen components
+	int *order = TourPool::local().buffer(n);
+	std::vector<char> seen(n, false);
+	int prev = -1, v = 0;
+	for (int i = 0; i < n; ++i) {
+		if (seen[v]) {
+			// Not a single cycle, which the cut condition rules out
+			TourPool::local().recycle_buffer(order, n);
+			return nullptr;
+		}
+		seen[v] = true;
+		order[i] = v;
+		const int *next = differs[v] && take_b[uf.find(v)] ? &bn[2*v] : &an[2*v];
+		int w = next[0] != prev ? next[0] : next[1];
+		prev = v;
+		v = w;
+	}
+	Tour *child = new Tour(order, n);
+
+	thread_local ActiveQueue queue(0);
+	queue.reset(n);
+	for (int v = 0; v < n; ++v) {
+		if (differs[v] && take_b[uf.find(v)])
+			queue.push(v);
+	}
+	lin_kernighan(*child, d, cand, queue, INT_MAX, deadline);
+	return child;
+}
+
+/// A memetic algorithm, which runs iterated local search on several
+/// copies of a tour and recombines them with partition crossover. The
+/// kicks are random, so the copies improve in different places, and
+/// the crossover collects the improvements of all copies in one tour.
+/// There is one member per thread. Each epoch gives every member a
+/// slice of time for iterated local search. The members are then
+/// merged pairwise in a tournament, where the shorter tour of each
+/// pair is crossed with the other one and the pairs of a round are
+/// crossed in parallel. The winner is copied to all members before the
+/// next epoch.
+/// @param construct The construction heuristic
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param seed The seed of the random number generators
+/// @param threads The number of threads, or 0 to use all cores
+/// @param deadline The time when the best tour must be returned
+/// @return The shortest tour found
+Tour* memetic(const Construction &construct, const Distance &d, const Candidates &cand,
+		unsigned seed, int threads, const Deadline &deadline) {
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	int size = std::max(MIN_MEMBERS, threads);
+	Random rng(stream_seed(seed, 0));
+	Tour *best = construct(rng);
+	lin_kernighan(*best, d, cand, INT_MAX, deadline);
+	if (best->size() < 8)
+		return best;
+
+	std::vector<Tour*> members(size, nullptr);
+	std::vector<Random> rngs;
+	for (int i = 0; i < size; ++i)
+		rngs.push_back(Random(stream_seed(seed, i + 1)));
+	// Each thread runs the iterated local search of this many members
+	int rounds = (size + threads - 1) / threads;
+	Workers workers(threads);
+	double merge_time = 0;
+	for (int epoch = EPOCHS; epoch > 0 && !deadline.expired(); --epoch) {
+		// Spread the remaining time evenly over the remaining epochs
+		double left = deadline.remaining() - MERGE_MARGIN * merge_time;
+		double slice = left / epoch / rounds;
+		members[0] = best;
+		for (int i = 1; i < size; ++i)
+			members[i] = new Tour(*best);
+		workers.run(size, [&](int i) {
+			Deadline kick(std::max(0.0, std::min(slice,
+				deadline.remaining() - MERGE_MARGIN * merge_time)));
+			ils(*members[i], d, cand, rngs[i], kick);
+		});
+
+		// Merge the members in a tournament
+		Clock::time_point start = Clock::now();
+		for (int count = size; count > 1; count = (count + 1) / 2) {
+			workers.run(count / 2, [&](int pair) {
+				Tour *&a = members[2 * pair], *&b = members[2 * pair + 1];
+				if (b->length(d) < a->length(d))
+					std::swap(a, b);
+				Tour *child = gpx(*a, *b, d, cand, deadline);
+				if (child && child->length(d) < a->length(d)) {
+					delete a;
+					a = child;
+				} else {
+					delete child;
+				}
+				delete b;
+			});
+			for (int i = 0; i < count; i += 2)
+				members[i / 2] = members[i];
+		}
+		best = members[0];
+		merge_time = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+	return best;
+}
@@ -0,0 +1,13 @@
+#ifndef __MEMETIC
+#define __MEMETIC
+
+#include "Tour.hpp"
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "deadline.hpp"
+#include "construction.hpp"
+
+Tour* memetic(const Construction&, const Distance&, const Candidates&, unsigned, int,
+	const Deadline&);
+
+#endif
@@ -1,103 +1,185 @@
 #include "mst.hpp"
-#include <limits.h>
-#include <iostream>
+#include "kdtree.hpp"
+#include "union_find.hpp"
+#include "tour_pool.hpp"
 #include <vector>
-#include <cstdlib>
 #include <algorithm>
 
-/// Create a random TSP tour from a minimum spanning tree.
-/// @param parent A minimum spanning tree
-/// @param size The number of cities
+/// Prepares the traversal of a tree. The children of every node are
+/// stored in one array, where the children of node i are found at the
+/// positions [_offset[i], _offset[i+1]).
+/// @param parent A tree, where parent[i] is the parent of node i or
+///               -1 if i is the root
+/// @param size The number of nodes
 /// @complexity O(n)
-Tour* mst_heuristic(int *parent, int size) {
-	// Create a neighbour list
-	std::vector<std::vector<int>> neighbors(size);
+MSTTours::MSTTours(const int *parent, int size)
+	: _offset(size + 1, 0), _child(std::max(size - 1, 0)), _root(0), _size(size) {
 	for (int i = 0; i < size; ++i) {
-		// Vertex i has parent[i] as parent
-		int pos = parent[i]; 
-		if (pos == -1) continue;
-		neighbors.at(pos).push_back(i);
+		if (parent[i] == -1)
+			_root = i;
+		else
+			++_offset[parent[i] + 1];
 	}
-	
-	// Traverse the tree in random order
+	for (int i = 0; i < size; ++i)
+		_offset[i + 1] += _offset[i];
+	std::vector<int> next(_offset.begin(), _offset.end() - 1);
 	for (int i = 0; i < size; ++i) {
-		std::random_shuffle(neighbors.at(i).begin(), neighbors.at(i).end());
+		if (parent[i] != -1)
+			_child[next[parent[i]]++] = i;
 	}
-	
-	int *pre_order = new int[size];
-	int pos = 0;
-
-	dfs(pre_order, pos, 0, neighbors);
-
-	Tour *t = new Tour(pre_order, size);
-	return t;
 }
 
-void dfs(int *pre_order, int &pos, int current, std::vector<std::vector<int>> &neighbors) {
-	pre_order[pos++] = current;
-	std::vector<int> to_visit = neighbors.at(current);
-	for (auto i = to_visit.begin(); i != to_visit.end(); ++i) {
-		dfs(pre_order, pos, *i, neighbors);
+/// Creates a random TSP tour from the tree, by visiting the nodes in
+/// depth first preorder, which shortcuts a walk around the tree. The
+/// children of each node are visited starting at a random child and
+/// in a random direction. The traversal needs no memory besides the
+/// tour itself, which is taken from the pool of the calling thread, so
+/// no heap memory is allocated once the pool is warmed up. The visited
+/// nodes fill the tour array from the front, and the stack of nodes to
+/// visit grows from the back. A node is never in both, so the two never
+/// meet. Tours can be created from several threads at once.
+/// @param rng The random number generator
+/// @complexity O(n)
+Tour* MSTTours::operator()(Random &rng) const {
+	int size = _size;
+	int *tour = TourPool::local().buffer(size);
+	if (size == 0)
+		return new Tour(tour, 0);
+	int visited = 0, top = size;
+	tour[--top] = _root;
+	while (top < size) {
+		int node = tour[top++];
+		tour[visited++] = node;
+		int first = _offset[node], count = _offset[node + 1] - first;
+		if (count == 0)
+			continue;
+		// Push the children such that they are popped in the chosen order
+		int start = random_int(rng, count);
+		int step = random_int(rng, 2) == 0 ? 1 : count - 1;
+		for (int i = 0, j = start; i < count; ++i, j = (j + step) % count)
+			tour[top - count + i] = _child[first + j];
+		top -= count;
 	}
+	return new Tour(tour, size);
 }
 
-/// A utility function to find the vertex with minimum key value, from
-/// the set of vertices not yet included in MST.
-int min_key(double key[], bool mst_set[], int V) {
-	int min = INT_MAX;
-	int min_index;
+/// An edge of the sparse graph the tree is built from.
+struct TreeEdge {
+	int a;
+	int b;
+	double dist;
 
-	for (int v = 0; v < V; ++v) {
-		if (!mst_set[v] && key[v] < min) {
-			min = key[v];
-			min_index = v;
-		}
+	bool operator<(const TreeEdge &e) const {
+		return dist < e.dist;
 	}
+};
 
-	return min_index;
-}
-
-/// Find a minimum spanning tree using Prim's algorithm.
-/// The tree is represented with an array A, such that A[i]
-/// contains the parent of the child node i or -1 if i is
-/// the root of the tree.
-/// @dist Distance matrix
-/// @V The number of vertices
-/// @parent The minimum spanning tree (output)
-/// @complexity O(n^2)
-void mst(double **d, int V, int *parent) {
-	// Key values used to pick minimum weight edge in cut
-	double *key = new double[V];
-	// To represent set of vertices not yet included in MST
-	bool *mst_set = new bool[V];
+/// Finds the shortest edges leaving the components of a spanning forest,
+/// except for the largest component, by asking the k-d tree for more
+/// and more neighbours of its cities until one lies outside. Adding the
+/// edges merges every component but the largest one with another.
+static void connect_components(const std::vector<City> &cities, UnionFind &sets,
+		std::vector<TreeEdge> &edges) {
+	int size = cities.size();
+	std::vector<int> component_size(size, 0);
+	for (int c = 0; c < size; ++c)
+		++component_size[sets.find(c)];
+	int largest = std::max_element(component_size.begin(), component_size.end())
+		- component_size.begin();
 
-	// Initialize all keys as INF
-	for (int i = 0; i < V; ++i) {
-		key[i] = INT_MAX, mst_set[i] = false;
+	KDTree tree(cities);
+	std::vector<TreeEdge> best(size);	// Shortest edge leaving a component
+	std::vector<char> found(size, false);
+	std::vector<int> ids;
+	std::vector<double> d2;
+	for (int c = 0; c < size; ++c) {
+		int root = sets.find(c);
+		if (root == largest)
+			continue;
+		for (int k = 8; ; k *= 2) {
+			k = std::min(k, size - 1);
+			ids.resize(k);
+			d2.resize(k);
+			int count = tree.nearest(cities[c].x, cities[c].y, c, k, ids.data(), d2.data());
+			int i = 0;
+			while (i < count && sets.find(ids[i]) == root)
+				++i;
+			if (i < count) {
+				if (!found[root] || d2[i] < best[root].dist) {
+					TreeEdge e = { c, ids[i], d2[i] };
+					best[root] = e;
+					found[root] = true;
+				}
+				break;
+			}
+			// No other component among the neighbours found so far
+			if (found[root] && d2[count - 1] >= best[root].dist)
+				break;
+		}
 	}
+	for (int c = 0; c < size; ++c) {
+		if (found[c])
+			edges.push_back(best[c]);
+	}
+}
 
-	key[0] = 0;     // Make key 0 so that this vertex is picked as first vertex
-	parent[0] = -1; // First node is always root of MST 
-
-	for (int count = 0; count < V-1; ++count) {
-		// Pick the minimum key vertex from the set of vertices
-		// not yet included in MST
-		int u = min_key(key, mst_set, V);
+/// Finds a Euclidean minimum spanning tree using Kruskal's algorithm on
+/// the candidate graph, which holds nearly all edges of the tree. Any
+/// components left when the candidate edges run out are connected in
+/// Borůvka rounds. The tree is represented with an array A, such that
+/// A[i] contains the parent of the child node i or -1 if i is the root
+/// of the tree. The root is city 0.
+/// @param cities The cities
+/// @param cand The candidate lists, preferably with quadrant neighbours
+/// @param parent The minimum spanning tree (output)
+/// @complexity O(nk log nk) when the candidate graph is (nearly) connected
+void mst(const std::vector<City> &cities, const Candidates &cand, int *parent) {
+	int size = cities.size();
+	if (size == 0)
+		return;
+	std::vector<TreeEdge> edges;
+	edges.reserve(static_cast<long>(size) * cand.k());
+	for (int a = 0; a < size; ++a) {
+		const int *near = cand[a];
+		for (int p = 0; p < cand.k(); ++p) {
+			TreeEdge e = { a, near[p], cand.dist(a, p) };
+			edges.push_back(e);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
 
-		// Add the picked vertex to the MST Set
-		mst_set[u] = true;
+	// Kruskal on the candidate graph, then on the shortest edges between
+	// the remaining components until the forest is a tree
+	UnionFind sets(size);
+	std::vector<std::vector<int> > adjacent(size);
+	int tree_edges = 0;
+	while (true) {
+		for (size_t i = 0; i < edges.size(); ++i) {
+			if (sets.unite(edges[i].a, edges[i].b)) {
+				adjacent[edges[i].a].push_back(edges[i].b);
+				adjacent[edges[i].b].push_back(edges[i].a);
+				++tree_edges;
+			}
+		}
+		if (tree_edges == size - 1)
+			break;
+		edges.clear();
+		connect_components(cities, sets, edges);
+		std::sort(edges.begin(), edges.end());
+	}
 
-		// Update key value and parent index of the adjacent vertices of
-		// the picked vertex. Consider only those vertices which are not yet
-		// included in MST
-		for (int v = 0; v < V; ++v) {
-			if (!mst_set[v] && d[u][v] <  key[v]) {
+	// Orient the tree from the root
+	std::vector<int> stack(1, 0);
+	parent[0] = -1;
+	while (!stack.empty()) {
+		int u = stack.back();
+		stack.pop_back();
+		for (size_t i = 0; i < adjacent[u].size(); ++i) {
+			int v = adjacent[u][i];
+			if (v != parent[u]) {
 				parent[v] = u;
-				key[v] = d[u][v];
+				stack.push_back(v);
 			}
 		}
 	}
-	
-	delete[] key;
-	delete[] mst_set;
 }
@@ -1,11 +1,25 @@
 #ifndef __MST
 #define __MST
 
+#include "main.hpp"
 #include "Tour.hpp"
+#include "candidates.hpp"
+#include "random.hpp"
 #include <vector>
 
-void mst(double**, int, int*);
-void dfs(int*, int&, int, std::vector<std::vector<int>>&);
-Tour* mst_heuristic(int*, int);
+/// Creates tours from a minimum spanning tree, such as the one built
+/// by mst(). The tree is stored once and shared by all tours.
+class MSTTours {
+	std::vector<int> _offset;	// Children of node i start at _offset[i]
+	std::vector<int> _child;	// The children of all nodes
+	int _root;
+	int _size;
+
+	public:
+	MSTTours(const int*, int);
+	Tour* operator()(Random&) const;
+};
+
+void mst(const std::vector<City>&, const Candidates&, int*);
 
 #endif
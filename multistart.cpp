@@ -0,0 +1,85 @@
+#include "multistart.hpp"
+#include "tsptools.hpp"
+#include "random.hpp"
+#include <atomic>
+#include <climits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+/// The best tour found so far by any worker. Workers only publish
+/// a tour when it improves on the incumbent, so at most one tour
+/// per worker is alive at any time besides the incumbent.
+class Incumbent {
+	std::mutex _lock;
+	Tour *_tour;
+	double _length;
+	int _restart;	// Breaks ties, so that the result is reproducible
+
+	public:
+	Incumbent() : _tour(nullptr), _length(0), _restart(-1) {}
+
+	/// Publishes a tour if it is better than the incumbent, and deletes
+	/// the tour which is no longer needed.
+	void offer(Tour *t, double length, int restart) {
+		std::lock_guard<std::mutex> guard(_lock);
+		if (_tour && (length > _length || (length == _length && restart > _restart))) {
+			delete t;
+			return;
+		}
+		delete _tour;
+		_tour = t;
+		_length = length;
+		_restart = restart;
+	}
+
+	Tour* release() {
+		Tour *t = _tour;
+		_tour = nullptr;
+		return t;
+	}
+};
+
+/// Builds tours with a construction heuristic and improves them using
+/// Lin-Kernighan, spread over a number of threads. Restarts are handed
+/// out one at a time from a shared counter, so that threads which
+/// finish early take over the remaining work. Restart i draws its
+/// random numbers from a generator seeded with (seed, i), which makes
+/// the result independent of the number of threads and of the
+/// scheduling.
+/// @param construct The construction heuristic
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param count The number of restarts
+/// @param seed The seed of the random number generators
+/// @param threads The number of threads, or 0 to use all cores
+/// @param deadline No more restarts are started after this deadline
+/// @return The shortest tour found
+Tour* multistart(const Construction &construct, const Distance &d, const Candidates &cand,
+		int count, unsigned seed, int threads, const Deadline &deadline) {
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::max(1, std::min(threads, count));
+
+	Incumbent best;
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		int i;
+		// Always make the first restart, so that there is a tour to return
+		while ((i = next++) < count && (i == 0 || !deadline.expired())) {
+			Random rng(stream_seed(seed, i));
+			Tour *t = construct(rng);
+			lin_kernighan(*t, d, cand, INT_MAX, deadline);
+			best.offer(t, t->length(d), i);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; ++i)
+		pool.push_back(std::thread(work));
+	work();
+	for (size_t i = 0; i < pool.size(); ++i)
+		pool[i].join();
+	return best.release();
+}
@@ -0,0 +1,13 @@
+#ifndef __MULTISTART
+#define __MULTISTART
+
+#include "Tour.hpp"
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "deadline.hpp"
+#include "construction.hpp"
+
+Tour* multistart(const Construction&, const Distance&, const Candidates&, int, unsigned,
+	int = 0, const Deadline& = Deadline());
+
+#endif
@@ -1,74 +1,275 @@
-#define NDEBUG
-
-#include "Tour.hpp"
+#include "nearest_insertion.hpp"
+#include "kdtree.hpp"
+#include "grid.hpp"
+#include "indexed_heap.hpp"
+#include "tour_pool.hpp"
+#include <algorithm>
 #include <cfloat>
-#include <assert.h>
-#include <cstdlib>
-
-/// Inserts the city i into the tour starting at the city specified,
-/// such that the quantity d[a][i] + d[i][b] - d[a][b] is minimised.
-/// @param i The city to insert
-/// @param start The first city in the tour
-/// @param tour The partial tour
-/// @param d The distance matrix
-void insert(int i, int start, int *tour, double **d) {
-	double min = DBL_MAX;
-	int a = -1, b = -1, c0 = start, c1 = tour[start];
-	do {
-		// Calculate the cost of inserting i between c0 and c1
-		double cost = d[c0][i] + d[i][c1] - d[c0][c1];
-		if (cost < min) {
-			min = cost;
-			a = c0;
-			b = c1;
+#include <cmath>
+
+// The number of tour cities close to a city whose tour edges are
+// tried when looking for the cheapest place to insert the city
+static const int INSERTION_NEIGHBOURS = 8;
+static const double EPS = 1e-9;
+
+/// The order in which the insertion heuristics pick cities.
+enum Selection {
+	NEAREST,	// The city closest to the tour
+	FARTHEST,	// The city farthest from the tour
+	CHEAPEST,	// The city with the cheapest insertion
+	RANDOM		// Cities in random order
+};
+
+/// A partial tour, grown by inserting cities between two neighbouring
+/// tour cities. The tour is a doubly linked list, and the tour cities
+/// are kept in a grid to find the tour edges close to a city.
+class PartialTour {
+	const std::vector<City> &_cities;
+	std::vector<int> _next, _prev;
+	std::vector<char> _in_tour;
+	Grid _grid;
+
+	double dist(int a, int b) const {
+		return _cities[a].dist(_cities[b]);
+	}
+
+	public:
+	PartialTour(const std::vector<City> &cities, int start)
+		: _cities(cities), _next(cities.size()), _prev(cities.size()),
+		_in_tour(cities.size(), false), _grid(cities) {
+		_next[start] = _prev[start] = start;
+		_in_tour[start] = true;
+		_grid.add(start);
+	}
+
+	int size() const {
+		return _grid.size();
+	}
+
+	bool contains(int c) const {
+		return _in_tour[c];
+	}
+
+	/// Returns the distance from a city to the closest tour city.
+	double distance_to(int c) const {
+		int id;
+		double d2;
+		_grid.nearest(_cities[c].x, _cities[c].y, 1, &id, &d2);
+		return std::sqrt(d2);
+	}
+
+	/// Finds the cheapest place to insert a city, among the tour edges
+	/// at the tour cities closest to it.
+	/// @param c The city to insert
+	/// @param after The city to insert c after (output)
+	/// @return The increase of the tour length
+	double cheapest(int c, int &after) const {
+		int ids[INSERTION_NEIGHBOURS];
+		double d2[INSERTION_NEIGHBOURS];
+		int found = _grid.nearest(_cities[c].x, _cities[c].y, INSERTION_NEIGHBOURS, ids, d2);
+		double best = DBL_MAX;
+		for (int i = 0; i < found; ++i) {
+			int t = ids[i];
+			// Try the edges (prev(t), t) and (t, next(t))
+			for (int a = _prev[t], j = 0; j < 2; a = t, ++j) {
+				int b = _next[a];
+				double cost = dist(a, c) + dist(c, b) - dist(a, b);
+				if (cost < best) {
+					best = cost;
+					after = a;
+				}
+			}
 		}
-		// Update c0 and c1
-		c0 = c1;
-		c1 = tour[c1];
-	} while(c0 != start);
-	// Insert i between a and b
-	tour[a] = i;
-	tour[i] = b;
+		return best;
+	}
+
+	/// Inserts a city between a tour city and the next one.
+	void insert(int c, int after) {
+		int b = _next[after];
+		_next[after] = c;
+		_prev[c] = after;
+		_next[c] = b;
+		_prev[b] = c;
+		_in_tour[c] = true;
+		_grid.add(c);
+	}
+
+	/// Inserts a city at the cheapest place.
+	void insert(int c) {
+		int after;
+		cheapest(c, after);
+		insert(c, after);
+	}
+
+	Tour* tour() const {
+		int size = _cities.size();
+		int *tour = TourPool::local().buffer(size);
+		for (int i = 0, c = 0; i < size; ++i, c = _next[c])
+			tour[i] = c;
+		return new Tour(tour, size);
+	}
+};
+
+/// Nearest insertion as described by Bentley. Each tour city t knows
+/// its closest city nn(t) outside the tour, found with a k-d tree from
+/// which the tour cities are removed. A heap on d(t, nn(t)) gives the
+/// city closest to the tour. Entries whose nn(t) has been inserted in
+/// the meantime are refreshed when they reach the top.
+static void insert_nearest(PartialTour &tour, const std::vector<City> &cities, int start) {
+	int size = cities.size();
+	KDTree outside(cities);
+	IndexedHeap heap(size);
+	std::vector<int> nn(size);
+	auto refresh = [&](int t) {
+		double d2;
+		if (outside.nearest(cities[t].x, cities[t].y, -1, 1, &nn[t], &d2) == 1)
+			heap.push(t, d2);
+		else
+			heap.remove(t);
+	};
+	outside.remove(start);
+	refresh(start);
+	while (tour.size() < size) {
+		int t = heap.top();
+		int c = nn[t];
+		if (!tour.contains(c)) {
+			tour.insert(c);
+			outside.remove(c);
+			refresh(c);
+		}
+		refresh(t);
+	}
 }
 
-/// Constructs a TSP tour using nearest insertion.
-/// @param d The distance matrix
-/// @param size The number of cities
-/// @complexity O(n^2)
-Tour* nearest_insertion(double **d, int size) {
-	if (size < 4) {
-		int *tour = new int[size];
-		for (int i = 0; i < size; ++i)
-			tour[i] = i;
-		Tour *t = new Tour(tour, size);
-		return t;
+/// Farthest insertion. The key of a city outside the tour is an upper
+/// bound of its distance to the tour, which can only decrease as cities
+/// are inserted. The top of the heap is recomputed using the grid of
+/// tour cities, and inserted once it is still the farthest city.
+static void insert_farthest(PartialTour &tour, const std::vector<City> &cities, int start) {
+	int size = cities.size();
+	IndexedHeap heap(size);	// Keys are negated distances
+	for (int c = 0; c < size; ++c) {
+		if (c != start)
+			heap.push(c, -cities[c].dist(cities[start]));
 	}
-	
-	// tour[i] should contain the next city to visit after i
-	int *tour = new int[size];
-	
-	// Randomly pick a triangle of three (unique) cities as the inital tour
-	int r0, r1, r2;
-	r0 = rand() % size;
-	r1 = rand() % size;
-	if (r1 == r0)
-		r1 = (r1 + 1) % size;
-	r2 = rand() % size;
-	while (r2 == r1 || r2 == r0)
-		r2 = (r2 + 1) % size;
-	tour[r0] = r1;
-	tour[r1] = r2;
-	tour[r2] = r0;
-	
-	// Insert the rest of the cities into the tour
-	for (int i = 0; i < size; ++i) {
-		if (i != r0 && i != r1 && i != r2) {
-			insert(i, r0, tour, d);
+	while (!heap.empty()) {
+		int c = heap.top();
+		double d = tour.distance_to(c);
+		if (d < -heap.key(c) - EPS) {
+			heap.push(c, -d);
+			continue;
 		}
+		heap.pop();
+		tour.insert(c);
+	}
+}
+
+/// Cheapest insertion. The key of a city outside the tour is its
+/// insertion cost when it was last computed. After an insertion, the
+/// costs of the candidate neighbours of the inserted city are updated,
+/// since the new tour edges are close to them. Costs further away may
+/// have increased because an edge was removed, so the top of the heap
+/// is recomputed before it is inserted.
+static void insert_cheapest(PartialTour &tour, const std::vector<City> &cities,
+		const Candidates &cand, int start) {
+	int size = cities.size();
+	IndexedHeap heap(size);
+	for (int c = 0; c < size; ++c) {
+		if (c != start)
+			heap.push(c, 2 * cities[c].dist(cities[start]));
 	}
-	
-	// Encapsulate the tour array into a tour object
-	Tour *t = new Tour(tour, size);
-	t->transform();
-	return t;
+	while (!heap.empty()) {
+		int c = heap.top(), after;
+		double cost = tour.cheapest(c, after);
+		if (cost > heap.key(c) + EPS) {
+			heap.push(c, cost);
+			continue;
+		}
+		heap.pop();
+		tour.insert(c, after);
+		const int *near = cand[c];
+		for (int p = 0; p < cand.k(); ++p) {
+			int x = near[p];
+			if (!heap.contains(x))
+				continue;
+			double update = tour.cheapest(x, after);
+			if (update < heap.key(x))
+				heap.push(x, update);
+		}
+	}
+}
+
+/// Builds a tour by inserting one city at a time at the cheapest place,
+/// starting from a random city.
+static Tour* insertion(const std::vector<City> &cities, const Candidates &cand, Random &rng,
+		Selection selection) {
+	int size = cities.size();
+	if (size == 0)
+		return new Tour(TourPool::local().buffer(0), 0);
+	int start = random_int(rng, size);
+	PartialTour tour(cities, start);
+	switch (selection) {
+		case NEAREST:
+			insert_nearest(tour, cities, start);
+			break;
+		case FARTHEST:
+			insert_farthest(tour, cities, start);
+			break;
+		case CHEAPEST:
+			insert_cheapest(tour, cities, cand, start);
+			break;
+		case RANDOM: {
+			std::vector<int> order;
+			for (int c = 0; c < size; ++c) {
+				if (c != start)
+					order.push_back(c);
+			}
+			std::shuffle(order.begin(), order.end(), rng);
+			for (size_t i = 0; i < order.size(); ++i)
+				tour.insert(order[i]);
+			break;
+		}
+	}
+	return tour.tour();
+}
+
+/// Constructs a TSP tour using nearest insertion. The city closest
+/// to the tour is inserted next.
+/// @param cities The cities
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @complexity O(n log n) expected
+Tour* nearest_insertion(const std::vector<City> &cities, const Candidates &cand, Random &rng) {
+	return insertion(cities, cand, rng, NEAREST);
+}
+
+/// Constructs a TSP tour using farthest insertion. The city farthest
+/// from the tour is inserted next, which outlines the shape of the
+/// instance early and usually gives the best tours of the family.
+/// @param cities The cities
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @complexity O(n log n) expected on evenly spread cities
+Tour* farthest_insertion(const std::vector<City> &cities, const Candidates &cand, Random &rng) {
+	return insertion(cities, cand, rng, FARTHEST);
+}
+
+/// Constructs a TSP tour using cheapest insertion. The city which
+/// increases the tour length the least is inserted next.
+/// @param cities The cities
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @complexity O(n log n) expected on evenly spread cities
+Tour* cheapest_insertion(const std::vector<City> &cities, const Candidates &cand, Random &rng) {
+	return insertion(cities, cand, rng, CHEAPEST);
+}
+
+/// Constructs a TSP tour using random insertion. The cities are
+/// inserted in random order.
+/// @param cities The cities
+/// @param cand The candidate lists
+/// @param rng The random number generator
+/// @complexity O(n log n) expected on evenly spread cities
+Tour* random_insertion(const std::vector<City> &cities, const Candidates &cand, Random &rng) {
+	return insertion(cities, cand, rng, RANDOM);
 }
@@ -1,5 +1,12 @@
 #ifndef __NI
 #define __NI
-void insert(int, int, int*, double**);
-Tour* nearest_insertion(double**, int);
+#include "main.hpp"
+#include "Tour.hpp"
+#include "candidates.hpp"
+#include "random.hpp"
+#include <vector>
+Tour* nearest_insertion(const std::vector<City>&, const Candidates&, Random&);
+Tour* farthest_insertion(const std::vector<City>&, const Candidates&, Random&);
+Tour* cheapest_insertion(const std::vector<City>&, const Candidates&, Random&);
+Tour* random_insertion(const std::vector<City>&, const Candidates&, Random&);
 #endif
@@ -1,45 +1,59 @@
-#include "Tour.hpp"
-#include <cstdlib>
-#include <unordered_set>
+#include "nearest_neighbour.hpp"
+#include "tour_pool.hpp"
 
 /// An implementation of the nearest neighbour (NN) construction
 /// algorithm for the TSP problem. NN is a greedy algorithm which
 /// selects a random city as the start of the tour, and city i+1
-/// as the unvisited city closest to i.
-/// @param d The distance matrix
-/// @param size The number of cities
-/// @complexity O(n^2)
-Tour* nearest_neighbour(double **d, int size) {
+/// as the unvisited city closest to i. The closest city is found
+/// using a k-d tree from which the visited cities are removed, so
+/// no distance matrix is needed. If the deadline expires, the
+/// remaining cities are appended in index order.
+/// @param cities The cities
+/// @param rng The random number generator
+/// @param deadline Stop searching when this deadline has expired
+/// @complexity O(n log n) expected
+Tour* nearest_neighbour(const std::vector<City> &cities, Random &rng, const Deadline &deadline) {
+	KDTree tree(cities);
+	return nearest_neighbour(cities, tree, rng, deadline);
+}
+
+/// Builds a nearest neighbour tour using a k-d tree which already
+/// contains all cities. All cities are put back into the tree before
+/// returning, so that one tree can be used for many tours.
+/// @param cities The cities
+/// @param tree A k-d tree over all the cities
+/// @param rng The random number generator
+/// @param deadline Stop searching when this deadline has expired
+/// @complexity O(n log n) expected
+Tour* nearest_neighbour(const std::vector<City> &cities, KDTree &tree, Random &rng,
+		const Deadline &deadline) {
+	int size = cities.size();
 	// Will contain the actual tour such that
 	// tour[n] contains the n:th city to visit
-	int *tour = new int[size];
+	int *tour = TourPool::local().buffer(size);
 	int n = 0;
-	// Use a set to keep track of visited cities
-	std::unordered_set<int> visited;
-	visited.reserve(size);
 	// Start the tour in a random city
-	int current = rand() % size;
-	visited.insert(current);
-	tour[n++] = current;
-	while (static_cast<int>(visited.size()) < size) {
-		int next = -1;
-		for (int j = 0; j < size; ++j) {
-			if (visited.count(j) == 0) {
-				// The city is not yet visited
-				if (next == -1) {
-					// No next city defined yet
-					next = j;
-					continue;
-				}
-				if (d[current][j] < d[current][next]) {
-					next = j;
-				}
+	int current = random_int(rng, size);
+	double d2;
+	while (true) {
+		tour[n++] = current;
+		tree.remove(current);
+		if (n == size)
+			break;
+		if (n % 256 == 0 && deadline.expired()) {
+			std::vector<char> visited(size, false);
+			for (int i = 0; i < n; ++i)
+				visited[tour[i]] = true;
+			for (int j = 0; j < size; ++j) {
+				if (!visited[j])
+					tour[n++] = j;
 			}
+			break;
 		}
-		tour[n++] = next;
-		visited.insert(next);
-		current = next;
+		const City &c = cities[current];
+		tree.nearest(c.x, c.y, -1, 1, &current, &d2);
 	}
+	tree.restore();
 	Tour* t = new Tour(tour, size);
 	return t;
 }
\ No newline at end of file
@@ -1,4 +1,11 @@
 #ifndef __NN
 #define __NN
-Tour* nearest_neighbour(double**, int);
+#include "main.hpp"
+#include "Tour.hpp"
+#include "kdtree.hpp"
+#include "deadline.hpp"
+#include "random.hpp"
+#include <vector>
+Tour* nearest_neighbour(const std::vector<City>&, Random&, const Deadline& = Deadline());
+Tour* nearest_neighbour(const std::vector<City>&, KDTree&, Random&, const Deadline& = Deadline());
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "parallel_opt2.hpp"
+#include "tsptools.hpp"
+#include "gain.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <map>
+#include <thread>
+#include <vector>
+
+static const double EPS = 1e-9;
+
+/// A 2-Opt move which removes the tour edges starting at the positions
+/// p and q, where p < q, by reversing the positions p+1 to q.
+struct Opt2Move {
+	int p, q;
+	double gain;
+
+	bool operator<(const Opt2Move &m) const {
+		return gain > m.gain;
+	}
+};
+
+/// Calls f(lo, hi, thread) on a number of threads, such that the
+/// ranges [lo, hi) partition [0, count).
+template <typename F>
+static void parallel_for(int count, int threads, F f) {
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; ++i)
+		pool.push_back(std::thread(f, static_cast<long>(count) * i / threads,
+			static_cast<long>(count) * (i + 1) / threads, i));
+	f(0, count / threads, 0);
+	for (size_t i = 0; i < pool.size(); ++i)
+		pool[i].join();
+}
+
+/// Finds the best improving 2-Opt move which adds an edge from the city
+/// at position i to one of its candidates. The gains of the moves are
+/// evaluated in batches.
+/// @return False if there is no improving move
+static bool best_move(const std::vector<int> &order, const std::vector<int> &pos,
+		const Distance &d, const Candidates &cand, int i, Opt2Move &move) {
+	int n = order.size();
+	int a = order[i];
+	const int *near = cand[a];
+	int cs[GAIN_BATCH], es[GAIN_BATCH], starts[GAIN_BATCH];
+	double gain[GAIN_BATCH];
+	move.gain = EPS;
+	for (int dir = 0; dir < 2; ++dir) {
+		// The removed edges start at e1 and e2, b is the other end of
+		// the edge at a, and e the other end of the edge at c.
+		int e1 = dir == 0 ? i : (i == 0 ? n - 1 : i - 1);
+		int b = order[dir == 0 ? (i + 1 == n ? 0 : i + 1) : e1];
+		double d_ab = d(a, b);
+		int p = 0;
+		while (p < cand.k()) {
+			int count = 0;
+			for (; p < cand.k() && count < GAIN_BATCH; ++p) {
+				if (cand.dist(a, p) >= d_ab) {
+					p = cand.k();
+					break;
+				}
+				int c = near[p], j = pos[c];
+				int e2 = dir == 0 ? j : (j == 0 ? n - 1 : j - 1);
+				int e = order[dir == 0 ? (j + 1 == n ? 0 : j + 1) : e2];
+				if (c == b || e == a)
+					continue;
+				cs[count] = c;
+				es[count] = e;
+				starts[count++] = e2;
+			}
+			two_opt_gains(d, a, b, d_ab, cs, es, count, gain);
+			for (int k = 0; k < count; ++k) {
+				if (gain[k] > move.gain) {
+					move.p = std::min(e1, starts[k]);
+					move.q = std::max(e1, starts[k]);
+					move.gain = gain[k];
+				}
+			}
+		}
+	}
+	return move.gain > EPS;
+}
+
+/// Improves a single tour using 2-Opt on a number of threads. Each round
+/// evaluates the best move for every active city in parallel, with the
+/// active cities split evenly between the threads. The improving moves
+/// are then picked greedily by gain, skipping moves whose reversed
+/// ranges overlap a move already picked. Such moves do not affect each
+/// other's gain, so they are all applied in parallel. The end points of
+/// the applied moves are active in the next round. When no improving
+/// move is left, serial Or-Opt finishes the tour, which also handles
+/// the few moves that are never picked because they overlap others.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param threads The number of threads, or 0 to use all cores
+/// @param deadline Stop when this deadline has expired
+void parallel_opt2(Tour &t, const Distance &d, const Candidates &cand, int threads,
+		const Deadline &deadline) {
+	int n = t.size();
+	if (n < 8) {
+		or2opt(t, d, cand, INT_MAX, deadline);
+		return;
+	}
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	t.track(d);
+
+	std::vector<int> order(n), pos(n);
+	for (int i = 0; i < n; ++i) {
+		order[i] = t[i];
+		pos[order[i]] = i;
+	}
+	std::vector<int> active(order);
+	std::vector<char> is_active(n, false);
+	std::vector<std::vector<Opt2Move> > found(threads);
+	std::vector<Opt2Move> picked;
+	std::map<int, int> ranges;	// Picked moves, first edge -> last edge
+
+	while (!active.empty() && !deadline.expired()) {
+		// Evaluate
+		parallel_for(active.size(), threads, [&](long lo, long hi, int thread) {
+			std::vector<Opt2Move> &moves = found[thread];
+			moves.clear();
+			Opt2Move move;
+			for (long i = lo; i < hi; ++i) {
+				if (best_move(order, pos, d, cand, pos[active[i]], move))
+					moves.push_back(move);
+			}
+		});
+
+		// Pick non-overlapping moves
+		std::vector<Opt2Move> moves;
+		for (int i = 0; i < threads; ++i)
+			moves.insert(moves.end(), found[i].begin(), found[i].end());
+		std::sort(moves.begin(), moves.end());
+		picked.clear();
+		ranges.clear();
+		for (size_t i = 0; i < moves.size(); ++i) {
+			const Opt2Move &m = moves[i];
+			std::map<int, int>::iterator after = ranges.upper_bound(m.p);
+			if (after != ranges.end() && after->first <= m.q)
+				continue;
+			if (after != ranges.begin() && (--after)->second >= m.p)
+				continue;
+			ranges[m.p] = m.q;
+			picked.push_back(m);
+		}
+
+		// Apply, the reversed ranges are disjoint
+		std::atomic<int> next(0);
+		parallel_for(threads, threads, [&](long, long, int) {
+			int i;
+			while ((i = next++) < static_cast<int>(picked.size())) {
+				for (int lo = picked[i].p + 1, hi = picked[i].q; lo < hi; ++lo, --hi) {
+					std::swap(order[lo], order[hi]);
+					pos[order[lo]] = lo;
+					pos[order[hi]] = hi;
+				}
+			}
+		});
+
+		// The end points of the changed edges are active next round
+		active.clear();
+		for (size_t i = 0; i < picked.size(); ++i) {
+			int ends[4] = { picked[i].p, picked[i].p + 1, picked[i].q, picked[i].q + 1 };
+			for (int j = 0; j < 4; ++j) {
+				int c = order[ends[j] == n ? 0 : ends[j]];
+				if (!is_active[c]) {
+					is_active[c] = true;
+					active.push_back(c);
+				}
+			}
+		}
+		for (size_t i = 0; i < active.size(); ++i)
+			is_active[active[i]] = false;
+	}
+
+	for (int i = 0; i < n; ++i)
+		t.set(i, order[i]);
+	or2opt(t, d, cand, INT_MAX, deadline);
+}
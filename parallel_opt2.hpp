@@ -0,0 +1,12 @@
+#ifndef __PARALLEL_OPT2
+#define __PARALLEL_OPT2
+
+#include "Tour.hpp"
+#include "distance.hpp"
+#include "candidates.hpp"
+#include "deadline.hpp"
+
+void parallel_opt2(Tour&, const Distance&, const Candidates&, int = 0,
+	const Deadline& = Deadline());
+
+#endif
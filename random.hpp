@@ -0,0 +1,28 @@
+#ifndef __RANDOM
+#define __RANDOM
+
+#include <random>
+
+/// The pseudo random number generator used by the construction
+/// heuristics. Every thread owns its own generator, so that runs
+/// with the same seed are reproducible.
+typedef std::mt19937 Random;
+
+/// Returns a uniformly distributed random integer in [0, n).
+inline int random_int(Random &rng, int n) {
+	return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+/// Returns the seed of stream i of a run with the given seed, such that
+/// every stream gets an unrelated generator. Unlike std::seed_seq, this
+/// does not allocate.
+inline unsigned stream_seed(unsigned seed, unsigned i) {
+	// The SplitMix64 finalizer of the pair
+	unsigned long long z = (static_cast<unsigned long long>(seed) << 32 | i) +
+		0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return static_cast<unsigned>(z ^ (z >> 31));
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "tour_pool.hpp"
+#include "Tour.hpp"
+#include <new>
+
+// The largest number of free items of each kind kept by a pool
+static const size_t POOL_CAPACITY = 8;
+
+/// Creates an empty pool, with room for the free items reserved up
+/// front such that recycling never allocates.
+TourPool::TourPool() : _size(-1) {
+	_buffers.reserve(POOL_CAPACITY);
+	_blocks.reserve(POOL_CAPACITY);
+}
+
+TourPool::~TourPool() {
+	for (size_t i = 0; i < _buffers.size(); ++i)
+		delete[] _buffers[i];
+	for (size_t i = 0; i < _blocks.size(); ++i)
+		::operator delete(_blocks[i]);
+}
+
+/// Returns the pool of the calling thread.
+TourPool& TourPool::local() {
+	thread_local TourPool pool;
+	return pool;
+}
+
+/// Returns a buffer of a number of ints, which is either recycled or
+/// allocated with new[].
+/// @complexity O(1) amortized
+int* TourPool::buffer(int size) {
+	if (size == _size && !_buffers.empty()) {
+		int *b = _buffers.back();
+		_buffers.pop_back();
+		return b;
+	}
+	return new int[size];
+}
+
+/// Gives back a buffer allocated with new[]. The pool only keeps buffers
+/// of the size it last saw, since restarts use one size.
+/// @complexity O(1) amortized
+void TourPool::recycle_buffer(int *b, int size) {
+	if (!b)
+		return;
+	if (size != _size) {
+		for (size_t i = 0; i < _buffers.size(); ++i)
+			delete[] _buffers[i];
+		_buffers.clear();
+		_size = size;
+	}
+	if (_buffers.size() < POOL_CAPACITY) {
+		_buffers.push_back(b);
+		return;
+	}
+	delete[] b;
+}
+
+/// Returns memory for a Tour object.
+void* TourPool::block(size_t size) {
+	if (size == sizeof(Tour) && !_blocks.empty()) {
+		void *p = _blocks.back();
+		_blocks.pop_back();
+		return p;
+	}
+	return ::operator new(size);
+}
+
+/// Gives back the memory of a Tour object.
+void TourPool::recycle_block(void *p, size_t size) {
+	if (!p)
+		return;
+	if (size == sizeof(Tour) && _blocks.size() < POOL_CAPACITY) {
+		_blocks.push_back(p);
+		return;
+	}
+	::operator delete(p);
+}
@@ -0,0 +1,31 @@
+#ifndef __TOUR_POOL
+#define __TOUR_POOL
+
+#include <cstddef>
+#include <vector>
+
+/// Recycles the memory of tours, so that restarts which build and
+/// discard tours of the same size do not touch the heap once warmed up.
+/// Every thread owns a pool of fixed-size permutation buffers and of
+/// Tour objects. Memory freed on one thread is kept by the pool of that
+/// thread, and each pool keeps at most a few items of each kind, which
+/// bounds the memory held to a small number of tours per thread.
+class TourPool {
+	std::vector<int*> _buffers;	// Free buffers of _size elements
+	std::vector<void*> _blocks;	// Free blocks for Tour objects
+	int _size;
+
+	TourPool();
+
+	public:
+	~TourPool();
+	TourPool(const TourPool&) = delete;
+	TourPool& operator=(const TourPool&) = delete;
+	static TourPool& local();
+	int* buffer(int);
+	void recycle_buffer(int*, int);
+	void* block(size_t);
+	void recycle_block(void*, size_t);
+};
+
+#endif
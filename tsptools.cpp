@@ -3,6 +3,9 @@
 #include "Tour.hpp"
 #include "main.hpp"
 #include "tsptools.hpp"
+#include "candidates.hpp"
+#include "distance.hpp"
+#include "gain.hpp"
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -15,27 +18,6 @@ void log(std::string msg) {
 #endif
 }
 
-static std::vector<City>* prox_list = nullptr;
-static City cmp_city;
-
-bool cmp_cities(City a, City b) {
-	return a.dist2(cmp_city) < b.dist2(cmp_city);
-}
-
-/// Computes an array of vectors sorted by distance, such
-/// that proximity_list[i].at(k) contains the k:th closest
-/// city to i.
-/// @param cities The cities used to build the proximity list
-/// @complexity O(n^2log n)
-void proximity_list(std::vector<City> &cities) { 
-	prox_list = new std::vector<City>[cities.size()];
-	for (size_t i = 0; i < cities.size(); ++i) {
-		prox_list[i] = cities;
-		cmp_city = cities.at(i);
-		std::sort(prox_list[i].begin(), prox_list[i].end(), cmp_cities);
-	}
-}
-
 /// Reverse the subtour j -> ... -> a.
 /// @param t The tour containing the subtour to be reversed
 /// @param j The start index
@@ -56,14 +38,14 @@ void opt2move(Tour &t, int j, int a) {
 
 /// Look at all unique edge pairs (i, j) and (a, b)
 /// and return true if an improvement was made.
-bool opt2search(Tour &tour, double **d) {
+bool opt2search(Tour &tour, const Distance &d) {
 	for (int j = 1; j < tour.size(); ++j) {
 		for (int b = j+2; b <= tour.size(); ++b) {
 			int I = tour[j-1];
 			int J = tour[j];
 			int A = tour[b-1];
 			int B = tour[b % tour.size()];
-			if (d[I][J] + d[A][B] > d[I][A] + d[J][B]) {
+			if (d(I, J) + d(A, B) > d(I, A) + d(J, B)) {
 				opt2move(tour, j, b-1);
 				return true;
 			}
@@ -77,47 +59,46 @@ bool opt2search(Tour &tour, double **d) {
 /// @param d The distance matrix
 /// @param max_iter The maximum number of swaps
 /// @complexity ~O(n^3)
-void opt2(Tour &t, double **d, int max_iter) {
+void opt2(Tour &t, const Distance &d, int max_iter) {
 	int iter = 0; // Number of edge swaps so far
 	while (opt2search(t, d) && ++iter < max_iter);
 }
 
-/// Search through the k-neighbourhood of j, i.e the k-1 closest cities
-/// to j, for each edge (i, j). To consider candidates for b, we need 
-/// only start at the beginning of j:s list and proceed down it until a 
-/// city x with d(j, x) ≥ d(i, j) is found. Returns true if an improvement 
-/// was found. 
-bool opt2ksearch(Tour &tour, double **d, int k) {
+/// Search through the candidate list of j for each edge (i, j). To
+/// consider candidates for b, we need only start at the beginning of
+/// j:s list and proceed down it until a city x with d(j, x) ≥ d(i, j)
+/// is found. Returns true if an improvement was found.
+bool opt2ksearch(Tour &tour, const Distance &d, const Candidates &cand) {
 	for (int j = 1; j < tour.size(); ++j) {
-		// Note that prox_list[j].at(0) contains j, skip this
-		// city by starting pos at 1.
-		for (int pos = 1; pos < k; ++pos) {
-			City &c = prox_list[j].at(pos);
-			int b = tour.index_of(c.name);
-			int I = tour[j-1];
-			int J = tour[j];
-			int B = tour[b]; // candidate for b
-			if (d[J][B] >= d[I][J]) {
-				// b is a good candidate. Check if the tour become
-				// shorter if the edge (i, j) and (a, b) is swapped.
-				int a = b == 0 ? tour.size() - 1 : b - 1;
-				int A = tour[a];
-				if (d[I][J] + d[A][B] > d[I][A] + d[J][B]) {
-					// Important, make sure the right part is swapped
-					// Case b < j : swap subarray b to i
-					// ---xxxxxxxxx--------------
-					//   ^^       ^^
-					//   ab       ij
-					// Case b >= j : swap subarray j to a 
-					// ----xxxxxxxxxxxxx---------
-					//    ^^           ^^
-					//    ij           ab
-					if (b < j)
-						opt2move(tour, b, j-1);
-					else
-						opt2move(tour, j, a);
-					return true;
-				} 
+		int I = tour[j-1];
+		int J = tour[j];
+		const int *near = cand[J];
+		for (int pos = 0; pos < cand.k(); ++pos) {
+			int B = near[pos]; // candidate for b
+			if (cand.dist(J, pos) >= d(I, J)) {
+				// The rest of the list is even farther away
+				break;
+			}
+			// b is a good candidate. Check if the tour become
+			// shorter if the edge (i, j) and (a, b) is swapped.
+			int b = tour.index_of(B);
+			int a = b == 0 ? tour.size() - 1 : b - 1;
+			int A = tour[a];
+			if (d(I, J) + d(A, B) > d(I, A) + d(J, B)) {
+				// Important, make sure the right part is swapped
+				// Case b < j : swap subarray b to i
+				// ---xxxxxxxxx--------------
+				//   ^^       ^^
+				//   ab       ij
+				// Case b >= j : swap subarray j to a 
+				// ----xxxxxxxxxxxxx---------
+				//    ^^           ^^
+				//    ij           ab
+				if (b < j)
+					opt2move(tour, b, j-1);
+				else
+					opt2move(tour, j, a);
+				return true;
 			}
 		}
 	}
@@ -125,101 +106,588 @@ bool opt2ksearch(Tour &tour, double **d, int k) {
 }
 
 /// Fast implementation of 2-Opt using neighbourhood search.
-/// @param tour The tour to improve
-/// @param proximity_list A list containing the k closest cities for each city
+/// @param t The tour to improve
 /// @param d The distance matrix
-/// @param k The number of neighbouring cities to consider
+/// @param cand The candidate lists, the k closest cities for each city
 /// @param max_iter The maximum number of swaps
-/// @complexity ~O(kn^2)
-void opt2k(std::vector<City> &cities, Tour &t, double **d, int k, int max_iter) {
-	if (k == 0) {
+/// @complexity ~O(kn) per swap
+void opt2k(Tour &t, const Distance &d, const Candidates &cand, int max_iter) {
+	if (cand.k() == 0) {
 		// Neighbourhood search disabled
 		return;
 	}
-	if (prox_list == nullptr) {
-		// Compute proximity list
-		proximity_list(cities);
-	}
 	int iter = 0;
-	while (opt2ksearch(t, d, k) && ++iter < max_iter);
+	while (opt2ksearch(t, d, cand) && ++iter < max_iter);
 }
 
-/// Computes a distance matrix D, such that D[i][j]
-/// is the distance between city i and j.
-double** pre_dist(std::vector<City> &cities) {
-	double **m = new double*[cities.size()];
-	for (size_t i = 0; i < cities.size(); ++i) {
-		m[i] = new double[cities.size()];
-		for (size_t j = 0; j < cities.size(); ++j) {
-			m[i][j] = cities.at(i).dist(cities.at(j));
+/// Improvements smaller than this are treated as zero, to avoid
+/// cycling on rounding errors.
+static const double EPS = 1e-9;
+
+/// Creates an empty queue for a tour with n cities.
+ActiveQueue::ActiveQueue(int n) : _queue(n), _active(n, false), _head(0), _count(0) {}
+
+/// Empties the queue and resizes it for a tour with n cities. The
+/// memory is kept, so reusing a queue for tours of the same size does
+/// not allocate.
+/// @complexity O(n)
+void ActiveQueue::reset(int n) {
+	_queue.resize(n);
+	_active.assign(n, false);
+	_head = 0;
+	_count = 0;
+}
+
+/// Activates a city, i.e turns off its don't-look bit.
+/// @complexity O(1)
+void ActiveQueue::push(int city) {
+	if (_active[city])
+		return;
+	_active[city] = true;
+	int tail = _head + _count;
+	if (tail >= static_cast<int>(_queue.size()))
+		tail -= _queue.size();
+	_queue[tail] = city;
+	++_count;
+}
+
+/// Removes and returns the city which has been active the longest.
+/// @complexity O(1)
+int ActiveQueue::pop() {
+	int city = _queue[_head];
+	if (++_head == static_cast<int>(_queue.size()))
+		_head = 0;
+	--_count;
+	_active[city] = false;
+	return city;
+}
+
+/// Returns true if no city is active.
+bool ActiveQueue::empty() const {
+	return _count == 0;
+}
+
+/// Activates all cities in tour order.
+/// @complexity O(n)
+void ActiveQueue::fill(const Tour &t) {
+	for (int i = 0; i < t.size(); ++i)
+		push(t[i]);
+}
+
+/// Tries to find an improving 2-Opt move which replaces one of the
+/// tour edges at a with an edge to one of its candidates c. The best
+/// such move is applied. The moves are collected in batches, whose
+/// gains are evaluated together. Returns true if an improvement was made.
+static bool improve_2opt(Tour &t, const Distance &d, const Candidates &cand, int a,
+		ActiveQueue &queue) {
+	const int *near = cand[a];
+	int cs[GAIN_BATCH], es[GAIN_BATCH];
+	double gain[GAIN_BATCH];
+	for (int dir = 0; dir < 2; ++dir) {
+		int b = dir == 0 ? t.next(a) : t.prev(a);
+		double d_ab = d(a, b);
+		double best = EPS;
+		int best_c = -1, best_d = -1;
+		int pos = 0;
+		while (pos < cand.k()) {
+			int count = 0;
+			for (; pos < cand.k() && count < GAIN_BATCH; ++pos) {
+				// The gain from replacing (a, b) with (a, c) must be positive
+				if (d_ab - cand.dist(a, pos) <= EPS) {
+					pos = cand.k();
+					break;
+				}
+				int c = near[pos];
+				int e = dir == 0 ? t.next(c) : t.prev(c);
+				if (c == b || e == a)
+					continue;
+				cs[count] = c;
+				es[count++] = e;
+			}
+			two_opt_gains(d, a, b, d_ab, cs, es, count, gain);
+			for (int i = 0; i < count; ++i) {
+				if (gain[i] > best) {
+					best = gain[i];
+					best_c = cs[i];
+					best_d = es[i];
+				}
+			}
+		}
+		if (best_c != -1) {
+			if (dir == 0)
+				t.two_opt(a, b, best_c, best_d);
+			else
+				t.two_opt(b, a, best_d, best_c);
+			queue.push(a);
+			queue.push(b);
+			queue.push(best_c);
+			queue.push(best_d);
+			return true;
 		}
 	}
-	return m;
+	return false;
 }
 
-void opt3(Tour &t, double **d, int max_iter) {
-	int iter = 0; // Number of edge swaps so far
-	while (opt3search(t, d) && ++iter < max_iter);
-}
-
-double select_min(double d0, double d1, double d2) {
-	double min = d0 < d1 ? d0 : d1;
-	return min < d2 ? min : d2;
-}
-
-bool opt3search(Tour &tour, double **dist) {
-	for (int b = 1; b < tour.size(); b++) {
-		for (int d = b + 2; d < tour.size(); d++) {
-			for (int f = d + 2; f < tour.size(); f++) {
-				// try to rearrange edges (a, b) (c, d) and (e, f)
-				int a = b - 1;
-				int c = d - 1;
-				int e = f - 1;
-
-				int A = tour[a];
-				int B = tour[b];
-				int C = tour[c];
-				int D = tour[d];
-				int E = tour[e];
-				int F = tour[f];
-
-				// Possible tours						Cost
-				// 0 >>>> ab >>>> cd >>>> ef >>>> ~		id
-				// 0 >>>> ad >>>> ec <<<< bf >>>> ~		d0
-				// 0 >>>> ac <<<< be >>>> df >>>> ~		d1
-				// 0 >>>> ae >>>> db >>>> cf >>>> ~		d2
-
-				double id = dist[A][B] + dist[C][D] + dist[E][F];
-				double d0 = dist[A][D] + dist[E][C] + dist[B][F];
-				double d1 = dist[A][C] + dist[B][E] + dist[D][F];
-				double d2 = dist[A][E] + dist[D][B] + dist[C][F];
-				
-				double min = select_min(d0, d1, d2);
-				if (min >= id) {
+/// An Or-Opt move which moves the path first -> ... -> last from
+/// between p and n to between u and v.
+struct OrMove {
+	int first, last, p, n, u, v;
+	bool reversed;	// Insert as u -> last ... first -> v
+};
+
+/// Applies an Or-Opt move using two or three 2-Opt moves.
+static void apply_or_move(Tour &t, const OrMove &m) {
+	// Insert the path reversed, i.e as u -> last ... first -> v
+	if (m.v == m.p) {
+		// Same as the case below when reading the tour backwards
+		t.two_opt(m.n, m.last, m.p, m.u);
+	} else if (m.u == m.n) {
+		t.two_opt(m.p, m.first, m.u, m.v);
+	} else {
+		// p first..last n ... u v  =>  p u ... n last..first v
+		t.two_opt(m.p, m.first, m.u, m.v);
+		// p u ... n last..first v  =>  p n ... u last..first v
+		t.two_opt(m.p, m.u, m.n, m.last);
+	}
+	if (!m.reversed) {
+		// u last..first v  =>  u first..last v
+		t.two_opt(m.u, m.last, m.first, m.v);
+	}
+}
+
+/// Tries to find an improving Or-Opt move for the paths of length
+/// 1-3 starting at a. The path is moved between a candidate of one
+/// of its endpoints and a tour neighbour of that candidate, possibly
+/// reversed. The best such move is applied. Returns true if an
+/// improvement was made.
+static bool improve_or_opt(Tour &t, const Distance &d, const Candidates &cand, int a,
+		ActiveQueue &queue) {
+	// The segment and the insertion point must not overlap
+	if (t.size() < 8)
+		return false;
+	double best = EPS;
+	OrMove move = OrMove();
+	for (int dir = 0; dir < 2; ++dir) {
+		int seg[3] = { a, a, a };
+		for (int len = 1; len <= 3; ++len) {
+			if (len > 1)
+				seg[len-1] = dir == 0 ? t.next(seg[len-2]) : t.prev(seg[len-2]);
+			else if (dir == 1)
+				continue; // A single city is the same in both directions
+			int first = dir == 0 ? a : seg[len-1];
+			int last = dir == 0 ? seg[len-1] : a;
+			int p = t.prev(first);
+			int n = t.next(last);
+			// Gain from removing the path and joining p and n
+			double g0 = d(p, first) + d(last, n) - d(p, n);
+			if (g0 <= EPS)
+				continue;
+			for (int end = 0; end < 2; ++end) {
+				int x = end == 0 ? first : last;
+				const int *near = cand[x];
+				for (int pos = 0; pos < cand.k(); ++pos) {
+					if (cand.dist(x, pos) >= g0)
+						break;
+					int c = near[pos];
+					if (std::find(seg, seg + len, c) != seg + len)
+						continue;
+					for (int side = 0; side < 2; ++side) {
+						int u = side == 0 ? c : t.prev(c);
+						int v = side == 0 ? t.next(c) : c;
+						if (std::find(seg, seg + len, u) != seg + len ||
+								std::find(seg, seg + len, v) != seg + len)
+							continue;
+						double forward = d(u, first) + d(last, v);
+						double backward = d(u, last) + d(first, v);
+						double gain = g0 + d(u, v) - std::min(forward, backward);
+						if (gain > best) {
+							best = gain;
+							move.first = first;
+							move.last = last;
+							move.p = p;
+							move.n = n;
+							move.u = u;
+							move.v = v;
+							move.reversed = backward < forward;
+						}
+					}
+				}
+			}
+		}
+	}
+	if (best <= EPS)
+		return false;
+	apply_or_move(t, move);
+	int touched[6] = { move.first, move.last, move.p, move.n, move.u, move.v };
+	for (int i = 0; i < 6; ++i)
+		queue.push(touched[i]);
+	return true;
+}
+
+/// Local search with 2-Opt and Or-Opt moves driven by candidate lists
+/// and don't-look bits. Only active cities are examined, and a city is
+/// activated again when one of its tour edges is changed.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param queue The active cities
+/// @param max_iter The maximum number of moves
+/// @param deadline Stop when this deadline has expired
+/// @complexity ~O(kn) per pass over the active cities
+void or2opt(Tour &t, const Distance &d, const Candidates &cand, ActiveQueue &queue,
+		int max_iter, const Deadline &deadline) {
+	// Every move updates the length, which is then free for the caller
+	t.track(d);
+	int iter = 0, steps = 0;
+	while (!queue.empty() && iter < max_iter) {
+		// Reading the clock is not free, only check now and then
+		if (++steps % 256 == 0 && deadline.expired())
+			break;
+		int a = queue.pop();
+		if (improve_2opt(t, d, cand, a, queue) || improve_or_opt(t, d, cand, a, queue))
+			++iter;
+	}
+}
+
+/// Local search with 2-Opt and Or-Opt moves until the tour is locally
+/// optimal with respect to the candidate lists.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param max_iter The maximum number of moves
+/// @param deadline Stop when this deadline has expired
+void or2opt(Tour &t, const Distance &d, const Candidates &cand, int max_iter,
+		const Deadline &deadline) {
+	if (t.size() < 5)
+		return;
+	// Every thread reuses its queue
+	thread_local ActiveQueue queue(0);
+	queue.reset(t.size());
+	queue.fill(t);
+	or2opt(t, d, cand, queue, max_iter, deadline);
+}
+
+/// A sequential 3-Opt move which removes the edges (t1, t2), (t3, t4)
+/// and (t5, t6), and adds (t2, t3), (t4, t5) and (t6, t1). If t6 is
+/// -1, the move is a 2-Opt move which adds (t2, t3) and (t4, t1).
+struct Opt3Move {
+	int t1, t2, t3, t4, t5, t6;
+	bool pure;	// t4 follows t3 in the direction from t1 to t2
+};
+
+/// Applies a 3-Opt move in place using 2-Opt moves.
+static void apply_opt3_move(Tour &t, const Opt3Move &m) {
+	if (!m.pure) {
+		// Two sequential 2-Opt moves, the first closes with (t4, t1)
+		t.two_opt(m.t2, m.t1, m.t3, m.t4);
+		if (m.t6 != -1)
+			t.two_opt(m.t4, m.t1, m.t5, m.t6);
+	} else if (t.next(m.t1) == m.t2 ? t.next(m.t5) == m.t6 : t.prev(m.t5) == m.t6) {
+		// t1 [t2..t5][t6..t3] t4  =>  t1 [t6..t3][t2..t5] t4
+		t.two_opt(m.t1, m.t2, m.t3, m.t4);
+		t.two_opt(m.t1, m.t3, m.t6, m.t5);
+		t.two_opt(m.t3, m.t5, m.t2, m.t4);
+	} else {
+		// t1 [t2..t6][t5..t3] t4  =>  t1 [t6..t2][t3..t5] t4
+		t.two_opt(m.t1, m.t2, m.t6, m.t5);
+		t.two_opt(m.t2, m.t5, m.t3, m.t4);
+	}
+}
+
+/// Searches for the best sequential 3-Opt move (including 2-Opt moves)
+/// which breaks one of the tour edges at t1. Only the candidates of t2
+/// and t4 are considered for t3 and t5. Both segment reversal and
+/// segment insertion (or3opt) moves are found. The best move is
+/// applied, and its endpoints are activated.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param t1 The city to start from
+/// @param queue The active cities
+/// @return True if an improvement was made
+/// @complexity O(k^2)
+bool opt3search(Tour &t, const Distance &d, const Candidates &cand, int t1,
+		ActiveQueue &queue) {
+	double best = EPS;
+	Opt3Move move = Opt3Move();
+	for (int dir = 0; dir < 2; ++dir) {
+		// suc and pred follow the direction from t1 to t2
+		bool fwd = dir == 0;
+		int t2 = fwd ? t.next(t1) : t.prev(t1);
+		double g0 = d(t1, t2);
+		for (int p3 = 0; p3 < cand.k(); ++p3) {
+			if (g0 - cand.dist(t2, p3) <= EPS)
+				break;
+			int t3 = cand[t2][p3];
+			if (t3 == t1)
+				continue;
+			double g1 = g0 - d(t2, t3);
+			for (int pure = 0; pure < 2; ++pure) {
+				int t3_suc = fwd ? t.next(t3) : t.prev(t3);
+				int t3_pred = fwd ? t.prev(t3) : t.next(t3);
+				int t4 = pure ? t3_suc : t3_pred;
+				if (t4 == t2 || (pure && t3 == t2))
 					continue;
+				double g2 = g1 + d(t3, t4);
+				if (!pure && g2 - d(t4, t1) > best) {
+					best = g2 - d(t4, t1);
+					move = { t1, t2, t3, t4, -1, -1, false };
 				}
-				
-				// Backup tour to be modified
-				int old[1000];
-				for (int i = a + 1; i < f; i++) 
-					old[i] = tour[i];
-				
-				// Write new tour
-				int pos = a + 1;
-				if (min == d0) {
-					for (int i = d; i <= e; i++) tour.set(pos++, old[i]);
-					for (int i = c; i >= b; i--) tour.set(pos++, old[i]);
-				} else if (min == d1) {
-					for (int i = c; i >= b; i--) tour.set(pos++, old[i]);
-					for (int i = e; i <= d; i++) tour.set(pos++, old[i]);
-				} else if (min == d2) {
-					for (int i = e; i <= d; i++) tour.set(pos++, old[i]);
-					for (int i = b; i <= c; i++) tour.set(pos++, old[i]);
+				for (int p5 = 0; p5 < cand.k(); ++p5) {
+					if (g2 - cand.dist(t4, p5) <= EPS)
+						break;
+					int t5 = cand[t4][p5];
+					if (t5 == t1)
+						continue;
+					// Is t5 on the path t2 -> t3, or t2 -> t4 when t4
+					// precedes t3, in the direction from t1 to t2?
+					int end = pure ? t3 : t4;
+					bool inside = fwd ? t.between(t2, t5, end) : t.between(end, t5, t2);
+					int t5_suc = fwd ? t.next(t5) : t.prev(t5);
+					int t5_pred = fwd ? t.prev(t5) : t.next(t5);
+					int choices[2] = { -1, -1 };
+					if (pure && inside) {
+						// Break the cycle t2 -> t3 -> t2 anywhere
+						choices[0] = t5_suc;
+						choices[1] = t5_pred;
+					} else if (!pure) {
+						// t6 must lie between t4 and t5 on the path t4 ... t1
+						choices[0] = inside ? t5_suc : t5_pred;
+					}
+					for (int i = 0; i < 2; ++i) {
+						int t6 = choices[i];
+						if (t6 == -1 || t6 == t1 || t6 == t4)
+							continue;
+						double gain = g2 - d(t4, t5) + d(t5, t6) - d(t6, t1);
+						if (gain > best) {
+							best = gain;
+							move = { t1, t2, t3, t4, t5, t6, pure == 1 };
+						}
+					}
 				}
+			}
+		}
+	}
+	if (best <= EPS)
+		return false;
+	apply_opt3_move(t, move);
+	int touched[6] = { move.t1, move.t2, move.t3, move.t4, move.t5, move.t6 };
+	for (int i = 0; i < 6; ++i) {
+		if (touched[i] != -1)
+			queue.push(touched[i]);
+	}
+	return true;
+}
+
+/// 3-Opt using neighbourhood search and don't-look bits. The moves are
+/// applied in place, so there is no limit on the size of the tour.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param max_iter The maximum number of moves
+/// @param deadline Stop when this deadline has expired
+/// @complexity ~O(k^2 n) per pass over the active cities
+void opt3(Tour &t, const Distance &d, const Candidates &cand, int max_iter,
+		const Deadline &deadline) {
+	if (t.size() < 8)
+		return;
+	t.track(d);
+	thread_local ActiveQueue queue(0);
+	queue.reset(t.size());
+	queue.fill(t);
+	int iter = 0, steps = 0;
+	while (!queue.empty() && iter < max_iter) {
+		if (++steps % 256 == 0 && deadline.expired())
+			break;
+		int a = queue.pop();
+		if (opt3search(t, d, cand, a, queue))
+			++iter;
+	}
+}
+
+// The number of alternatives for t3 which are tried at the first
+// levels of a Lin-Kernighan move, deeper levels only try the best.
+static const int LK_MAX_BREADTH = 5;
+static const int LK_BREADTH[] = { LK_MAX_BREADTH, 3, 1 };
+static const int LK_LEVELS = sizeof(LK_BREADTH) / sizeof(LK_BREADTH[0]);
+// The maximum number of 2-Opt moves in a Lin-Kernighan move
+static const int LK_DEPTH = 50;
+
+/// Builds Lin-Kernighan moves starting at a fixed city t1. Each level
+/// of a move is a 2-Opt move which removes the edge (t1, t2), adds
+/// (t2, t3) for a candidate t3 of t2, removes (t3, t4) and closes the
+/// tour with (t4, t1). The next level continues from t2 = t4. The gain
+/// criterion requires the sum of removed minus added edges, excluding
+/// the closing edge, to be positive at every level.
+class LinKernighan {
+	Tour &_t;
+	const Distance &_d;
+	const Candidates &_cand;
+	int _t1;
+	std::vector<int> &_log;		// Applied 2-Opt moves, four cities each
+	std::vector<int> &_added;	// Edges added by the current move
+	std::vector<int> &_removed;	// Edges removed by the current move
+	double _best;				// The best gain of a closed move so far
+	size_t _best_len;			// The length of _log for the best gain
+
+	/// Checks if the edge (a, b) is in a list of edges.
+	static bool contains(const std::vector<int> &edges, int a, int b) {
+		for (size_t i = 0; i < edges.size(); i += 2) {
+			if ((edges[i] == a && edges[i+1] == b) || (edges[i] == b && edges[i+1] == a))
 				return true;
+		}
+		return false;
+	}
+
+	void apply(int a, int b, int c, int d) {
+		_t.two_opt(a, b, c, d);
+		int move[4] = { a, b, c, d };
+		_log.insert(_log.end(), move, move + 4);
+	}
+
+	void undo() {
+		size_t i = _log.size() - 4;
+		// Swap back the edges (a, c) and (b, d) for (a, b) and (c, d)
+		_t.two_opt(_log[i], _log[i+2], _log[i+1], _log[i+3]);
+		_log.resize(i);
+	}
+
+	/// Extends the current move, where g is the gain so far and
+	/// (t1, t2) is the edge to break next.
+	void step(int level, int t2, double g) {
+		struct Alternative {
+			int t3, t4;
+			double g;
+		} alt[LK_MAX_BREADTH];
+		int breadth = level < LK_LEVELS ? LK_BREADTH[level] : 1;
+		int count = 0;
+
+		// Pick the alternatives with the largest g - d(t2, t3) + d(t3, t4)
+		bool succ = _t.next(_t1) == t2;
+		const int *near = _cand[t2];
+		for (int pos = 0; pos < _cand.k(); ++pos) {
+			if (g - _cand.dist(t2, pos) <= EPS)
+				break;
+			int t3 = near[pos];
+			int t4 = succ ? _t.prev(t3) : _t.next(t3);
+			if (t3 == _t1 || t4 == t2)
+				continue;
+			if (contains(_removed, t2, t3) || contains(_added, t3, t4))
+				continue;
+			double g2 = g - _d(t2, t3) + _d(t3, t4);
+			if (count == breadth && g2 <= alt[count-1].g)
+				continue;
+			int i = count < breadth ? count++ : breadth - 1;
+			for (; i > 0 && alt[i-1].g < g2; --i)
+				alt[i] = alt[i-1];
+			alt[i].t3 = t3;
+			alt[i].t4 = t4;
+			alt[i].g = g2;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			int t3 = alt[i].t3, t4 = alt[i].t4;
+			apply(t2, _t1, t3, t4);
+			int added[2] = { t2, t3 }, removed[2] = { t3, t4 };
+			_added.insert(_added.end(), added, added + 2);
+			_removed.insert(_removed.end(), removed, removed + 2);
+
+			double close = alt[i].g - _d(t4, _t1);
+			if (close > _best) {
+				_best = close;
+				_best_len = _log.size();
+			}
+			if (level + 1 < LK_DEPTH)
+				step(level + 1, t4, alt[i].g);
+			if (_best_len > 0) {
+				// Keep the move, the caller rolls back to the best level
+				return;
 			}
+			undo();
+			_added.resize(_added.size() - 2);
+			_removed.resize(_removed.size() - 2);
 		}
 	}
-	return false;
+
+	public:
+	/// Creates a move builder, which keeps its move logs in scratch
+	/// vectors owned by the caller.
+	LinKernighan(Tour &t, const Distance &d, const Candidates &cand, std::vector<int> &log,
+			std::vector<int> &added, std::vector<int> &removed)
+		: _t(t), _d(d), _cand(cand), _t1(-1), _log(log), _added(added), _removed(removed),
+		_best(0), _best_len(0) {}
+
+	/// Tries to find an improving move starting at t1, breaking either
+	/// of its tour edges. Returns true if an improvement was made. Only
+	/// the 2-Opt moves which are kept are recorded in the journal of the
+	/// tour, not the trial moves which are undone.
+	bool improve(int t1, ActiveQueue &queue) {
+		_t1 = t1;
+		std::vector<int> *journal = _t.journal();
+		_t.journal(nullptr);
+		for (int dir = 0; dir < 2; ++dir) {
+			int t2 = dir == 0 ? _t.next(t1) : _t.prev(t1);
+			_log.clear();
+			_added.clear();
+			_removed.clear();
+			_best = EPS;
+			_best_len = 0;
+			step(0, t2, _d(t1, t2));
+			if (_best_len == 0)
+				continue;
+			while (_log.size() > _best_len)
+				undo();
+			for (size_t i = 0; i < _log.size(); ++i)
+				queue.push(_log[i]);
+			if (journal)
+				journal->insert(journal->end(), _log.begin(), _log.end());
+			_t.journal(journal);
+			return true;
+		}
+		_t.journal(journal);
+		return false;
+	}
+};
+
+/// Or-Opt combined with Lin-Kernighan style variable-depth moves. Each
+/// active city is first used as t1 of a Lin-Kernighan move, and if no
+/// such move improves the tour an Or-Opt move is tried.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param queue The active cities
+/// @param max_iter The maximum number of moves
+/// @param deadline Stop when this deadline has expired
+void lin_kernighan(Tour &t, const Distance &d, const Candidates &cand, ActiveQueue &queue,
+		int max_iter, const Deadline &deadline) {
+	t.track(d);
+	// The move logs of every thread are reused between calls
+	thread_local std::vector<int> applied, added, removed;
+	LinKernighan lk(t, d, cand, applied, added, removed);
+	int iter = 0, steps = 0;
+	while (!queue.empty() && iter < max_iter) {
+		// Reading the clock is not free, only check now and then
+		if (++steps % 256 == 0 && deadline.expired())
+			break;
+		int a = queue.pop();
+		if (lk.improve(a, queue) || improve_or_opt(t, d, cand, a, queue))
+			++iter;
+	}
 }
 
+/// Or-Opt combined with Lin-Kernighan style variable-depth moves, until
+/// the tour is locally optimal with respect to the candidate lists.
+/// @param t The tour to improve
+/// @param d The distance provider
+/// @param cand The candidate lists
+/// @param max_iter The maximum number of moves
+/// @param deadline Stop when this deadline has expired
+void lin_kernighan(Tour &t, const Distance &d, const Candidates &cand, int max_iter,
+		const Deadline &deadline) {
+	if (t.size() < 5)
+		return;
+	thread_local ActiveQueue queue(0);
+	queue.reset(t.size());
+	queue.fill(t);
+	lin_kernighan(t, d, cand, queue, max_iter, deadline);
+}
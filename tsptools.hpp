@@ -3,16 +3,39 @@
 
 #include "main.hpp"
 #include "Tour.hpp"
+#include "candidates.hpp"
+#include "distance.hpp"
+#include "deadline.hpp"
 #include <vector>
 
-void opt2(Tour&, double**, int);
-void opt2k(std::vector<City>&, Tour&, double**, int, int);
+/// A queue of active cities for local search with don't-look bits.
+/// A city is in the queue exactly when its don't-look bit is off.
+class ActiveQueue {
+	std::vector<int> _queue;
+	std::vector<bool> _active;
+	int _head;
+	int _count;
 
-void opt3(Tour &t, double **d, int max_iter);
-bool opt3search(Tour &tour, double **d);
+	public:
+	ActiveQueue(int);
+	void reset(int);
+	void push(int);
+	int pop();
+	bool empty() const;
+	void fill(const Tour&);
+};
 
-double** pre_dist(std::vector<City>&);
-bool compare_cities(City, City);
-void proximity_list(std::vector<City>&);
+void opt2(Tour&, const Distance&, int);
+void opt2k(Tour&, const Distance&, const Candidates&, int);
+void or2opt(Tour&, const Distance&, const Candidates&, int, const Deadline& = Deadline());
+void or2opt(Tour&, const Distance&, const Candidates&, ActiveQueue&, int,
+	const Deadline& = Deadline());
+
+void opt3(Tour&, const Distance&, const Candidates&, int, const Deadline& = Deadline());
+bool opt3search(Tour&, const Distance&, const Candidates&, int, ActiveQueue&);
+
+void lin_kernighan(Tour&, const Distance&, const Candidates&, int, const Deadline& = Deadline());
+void lin_kernighan(Tour&, const Distance&, const Candidates&, ActiveQueue&, int,
+	const Deadline& = Deadline());
 
 #endif
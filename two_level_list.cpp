@@ -0,0 +1,222 @@
+#include "two_level_list.hpp"
+#include <algorithm>
+#include <cmath>
+
+/// Creates a two-level list from an order based tour.
+/// @param tour The tour, tour[i] is the i:th city to visit
+/// @param size The number of cities
+/// @complexity O(n)
+TwoLevelList::TwoLevelList(const int *tour, int size)
+	: _size(size), _city(size), _pos(size), _seg(size) {
+	_group = std::max(8, static_cast<int>(std::sqrt(static_cast<double>(size))));
+	int segments = (size + _group - 1) / _group;
+	_max_segments = 2 * segments + 8;
+	rebuild(tour);
+}
+
+/// Rebuilds the list from an order based tour, with all segments
+/// of the same size and no reverse bits set.
+void TwoLevelList::rebuild(const int *tour) {
+	int segments = (_size + _group - 1) / _group;
+	_lo.resize(segments);
+	_hi.resize(segments);
+	_rev.assign(segments, false);
+	_rank.resize(segments);
+	_order.resize(segments);
+	for (int s = 0; s < segments; ++s) {
+		_lo[s] = s * _group;
+		_hi[s] = std::min(_size, (s + 1) * _group);
+		_rank[s] = s;
+		_order[s] = s;
+	}
+	for (int i = 0; i < _size; ++i) {
+		int c = tour[i];
+		_city[i] = c;
+		_pos[c] = i;
+		_seg[c] = i / _group;
+	}
+}
+
+/// Returns the number of cities.
+int TwoLevelList::size() const {
+	return _size;
+}
+
+/// Returns the first city of a segment in tour order.
+int TwoLevelList::first(int s) const {
+	return _rev[s] ? _city[_hi[s] - 1] : _city[_lo[s]];
+}
+
+/// Returns the last city of a segment in tour order.
+int TwoLevelList::last(int s) const {
+	return _rev[s] ? _city[_lo[s]] : _city[_hi[s] - 1];
+}
+
+/// Returns a number which increases along the tour, starting
+/// from the first city of the first segment.
+long TwoLevelList::sequence(int c) const {
+	int s = _seg[c];
+	int offset = _rev[s] ? _hi[s] - 1 - _pos[c] : _pos[c] - _lo[s];
+	return static_cast<long>(_rank[s]) * _size + offset;
+}
+
+/// Returns the city visited after a city.
+/// @complexity O(1)
+int TwoLevelList::next(int c) const {
+	int s = _seg[c], p = _pos[c];
+	if (_rev[s]) {
+		if (p > _lo[s])
+			return _city[p - 1];
+	} else if (p + 1 < _hi[s]) {
+		return _city[p + 1];
+	}
+	int r = _rank[s] + 1;
+	return first(_order[r == static_cast<int>(_order.size()) ? 0 : r]);
+}
+
+/// Returns the city visited before a city.
+/// @complexity O(1)
+int TwoLevelList::prev(int c) const {
+	int s = _seg[c], p = _pos[c];
+	if (_rev[s]) {
+		if (p + 1 < _hi[s])
+			return _city[p + 1];
+	} else if (p > _lo[s]) {
+		return _city[p - 1];
+	}
+	int r = _rank[s] == 0 ? _order.size() - 1 : _rank[s] - 1;
+	return last(_order[r]);
+}
+
+/// Checks if b lies on the path from a to c, following next().
+/// @complexity O(1)
+bool TwoLevelList::between(int a, int b, int c) const {
+	long i = sequence(a), j = sequence(b), k = sequence(c);
+	if (i <= k)
+		return i <= j && j <= k;
+	return j >= i || j <= k;
+}
+
+/// Splits the segment of a city, such that the city becomes the first
+/// city of a segment. The smaller part is moved to a new segment.
+/// @complexity O(sqrt n)
+void TwoLevelList::split(int c) {
+	int s = _seg[c];
+	if (first(s) == c)
+		return;
+	int p = _pos[c];
+	// The ranges before c and starting at c, in tour order
+	int before_lo, before_hi, after_lo, after_hi;
+	if (_rev[s]) {
+		before_lo = p + 1;
+		before_hi = _hi[s];
+		after_lo = _lo[s];
+		after_hi = p + 1;
+	} else {
+		before_lo = _lo[s];
+		before_hi = p;
+		after_lo = p;
+		after_hi = _hi[s];
+	}
+	bool move_after = after_hi - after_lo <= before_hi - before_lo;
+	int t = _lo.size();
+	_lo.push_back(move_after ? after_lo : before_lo);
+	_hi.push_back(move_after ? after_hi : before_hi);
+	_rev.push_back(_rev[s]);
+	_rank.push_back(0);
+	_lo[s] = move_after ? before_lo : after_lo;
+	_hi[s] = move_after ? before_hi : after_hi;
+	for (int i = _lo[t]; i < _hi[t]; ++i)
+		_seg[_city[i]] = t;
+
+	// Insert the new segment next to the old one
+	int r = move_after ? _rank[s] + 1 : _rank[s];
+	_order.insert(_order.begin() + r, t);
+	for (int i = r; i < static_cast<int>(_order.size()); ++i)
+		_rank[_order[i]] = i;
+}
+
+/// Reverses the segments with ranks from r1 to r2, wrapping around
+/// the end of the segment order if r2 < r1.
+/// @complexity O(sqrt n)
+void TwoLevelList::reverse_segments(int r1, int r2) {
+	int count = _order.size();
+	int len = r2 - r1;
+	if (len < 0)
+		len += count;
+	++len;
+	if (2 * len > count) {
+		// Reverse the other segments instead
+		int tmp = r1;
+		r1 = r2 + 1 == count ? 0 : r2 + 1;
+		r2 = tmp == 0 ? count - 1 : tmp - 1;
+		len = count - len;
+	}
+	for (int i = r1, j = r2, k = 0; k < len; ++k) {
+		if (k < len / 2)
+			std::swap(_order[i], _order[j]);
+		if (++i == count) i = 0;
+		if (--j < 0) j = count - 1;
+	}
+	for (int i = r1, k = 0; k < len; ++k) {
+		int s = _order[i];
+		_rev[s] = !_rev[s];
+		_rank[s] = i;
+		if (++i == count) i = 0;
+	}
+}
+
+/// Reverses the path from a to b, which lies within one segment.
+/// @complexity O(sqrt n)
+void TwoLevelList::reverse_inside(int a, int b) {
+	int i = std::min(_pos[a], _pos[b]);
+	int j = std::max(_pos[a], _pos[b]);
+	for (; i < j; ++i, --j) {
+		std::swap(_city[i], _city[j]);
+		_pos[_city[i]] = i;
+		_pos[_city[j]] = j;
+	}
+}
+
+/// Reverses the path from city a to city b. As for Tour::flip, the
+/// rest of the tour may be reversed instead.
+/// @param a The first city of the path
+/// @param b The last city of the path
+/// @complexity O(sqrt n) amortized
+void TwoLevelList::flip(int a, int b) {
+	if (a == b || next(b) == a)
+		return; // Nothing to reverse, or the whole tour
+	if (_seg[a] == _seg[b]) {
+		if (sequence(a) <= sequence(b))
+			reverse_inside(a, b);
+		else
+			reverse_inside(next(b), prev(a)); // The rest of the tour
+		return;
+	}
+	split(a);
+	split(next(b));
+	reverse_segments(_rank[_seg[a]], _rank[_seg[b]]);
+	if (static_cast<int>(_order.size()) > _max_segments) {
+		std::vector<int> tour(_size);
+		write(tour.data());
+		rebuild(tour.data());
+	}
+}
+
+/// Writes the tour in order based form, starting with the first
+/// city of the first segment.
+/// @param tour The output array, tour[i] is the i:th city to visit
+/// @complexity O(n)
+void TwoLevelList::write(int *tour) const {
+	int i = 0;
+	for (size_t r = 0; r < _order.size(); ++r) {
+		int s = _order[r];
+		if (_rev[s]) {
+			for (int p = _hi[s] - 1; p >= _lo[s]; --p)
+				tour[i++] = _city[p];
+		} else {
+			for (int p = _lo[s]; p < _hi[s]; ++p)
+				tour[i++] = _city[p];
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef __TWO_LEVEL_LIST
+#define __TWO_LEVEL_LIST
+
+#include <vector>
+
+/// A two-level list representation of a tour, which supports reversing
+/// a path in O(sqrt n) time. The cities are divided into segments of
+/// about sqrt(n) consecutive cities. Each segment is a range of an
+/// array and has a reverse bit, and the order of the segments in the
+/// tour is kept in a second, much shorter, array. Reversing a path
+/// splits at most two segments and then reverses a range of segments,
+/// by reordering them and toggling their reverse bits. Paths within a
+/// single segment are reversed in place. Once the splits have doubled
+/// the number of segments, the list is rebuilt.
+class TwoLevelList {
+	int _size;
+	int _group;					// Size of the segments after a rebuild
+	int _max_segments;			// Rebuild when there are more segments
+	std::vector<int> _city;		// Cities, segments are ranges of this array
+	std::vector<int> _pos;		// _pos[c] is the index of city c in _city
+	std::vector<int> _seg;		// _seg[c] is the segment of city c
+	std::vector<int> _lo;		// First index of a segment in _city
+	std::vector<int> _hi;		// One past the last index of a segment
+	std::vector<char> _rev;		// Reverse bit of a segment
+	std::vector<int> _rank;		// Position of a segment in _order
+	std::vector<int> _order;	// The segments in tour order
+
+	int first(int) const;
+	int last(int) const;
+	long sequence(int) const;
+	void split(int);
+	void reverse_segments(int, int);
+	void reverse_inside(int, int);
+	void rebuild(const int*);
+
+	public:
+	TwoLevelList(const int*, int);
+	int size() const;
+	int next(int) const;
+	int prev(int) const;
+	bool between(int, int, int) const;
+	void flip(int, int);
+	void write(int*) const;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "union_find.hpp"
+
+/// Creates n singleton sets.
+/// @complexity O(n)
+UnionFind::UnionFind(int n) : _parent(n), _size(n, 1) {
+	for (int i = 0; i < n; ++i)
+		_parent[i] = i;
+}
+
+/// Returns the representative of the set containing x.
+/// @complexity O(α(n)) amortized
+int UnionFind::find(int x) {
+	while (_parent[x] != x) {
+		_parent[x] = _parent[_parent[x]];
+		x = _parent[x];
+	}
+	return x;
+}
+
+/// Merges the sets containing a and b.
+/// @return False if a and b already were in the same set
+/// @complexity O(α(n)) amortized
+bool UnionFind::unite(int a, int b) {
+	a = find(a);
+	b = find(b);
+	if (a == b)
+		return false;
+	if (_size[a] < _size[b]) {
+		int tmp = a;
+		a = b;
+		b = tmp;
+	}
+	_parent[b] = a;
+	_size[a] += _size[b];
+	return true;
+}
@@ -0,0 +1,18 @@
+#ifndef __UNION_FIND
+#define __UNION_FIND
+
+#include <vector>
+
+/// Disjoint sets over the integers [0, n), with union by size and
+/// path halving.
+class UnionFind {
+	std::vector<int> _parent;
+	std::vector<int> _size;
+
+	public:
+	UnionFind(int);
+	int find(int);
+	bool unite(int, int);
+};
+
+#endif